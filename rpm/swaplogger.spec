@@ -9,6 +9,7 @@ Source0:    %{name}-%{version}.tar.gz
 BuildRequires:  pkgconfig(x11)
 BuildRequires:  pkgconfig(xdamage)
 BuildRequires:  pkgconfig(egl)
+BuildRequires:  pkgconfig(glesv2)
 BuildRequires:  pkgconfig(xext)
 
 %description
@@ -29,11 +30,13 @@ rm -rf %{buildroot}
 install -D -p -m 0755 swaplogger %{buildroot}%{_bindir}/swaplogger
 install -D -p -m 0644 swaplogger.so %{buildroot}%{_libdir}/swaplogger.so
 ln %{buildroot}%{_libdir}/swaplogger.so %{buildroot}%{_libdir}/swaplogger.so.1
+install -D -p -m 0644 swaplogger_markers.h %{buildroot}%{_includedir}/swaplogger_markers.h
 
 %files
 %defattr(-,root,root,-)
 %{_bindir}/swaplogger
 %{_libdir}/swaplogger.so
 %{_libdir}/swaplogger.so.1
+%{_includedir}/swaplogger_markers.h
 
 
@@ -25,6 +25,7 @@
  *  Sami Kyöstilä <sami.kyostila@nokia.com>
  */
 #include <sys/time.h>
+#include <sys/socket.h>
 
 #include <time.h>
 #include <dlfcn.h>
@@ -39,8 +40,18 @@
 #include <signal.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <stdarg.h>
 
 #include "swaplogger.h"
+#include "swaplogger_format.h"
+#include "swaplogger_control.h"
+#include "swaplogger_recorder.h"
+#include "swaplogger_phase.h"
+#include "swaplogger_heatmap.h"
+#include "swaplogger_rollup.h"
+#include "swaplogger_sampler.h"
+#include "swaplogger_gate.h"
+#include "swaplogger_backtrace.h"
 
 #define MAX_TIMESTAMPS  4096
 
@@ -48,6 +59,10 @@
 #   include "swaplogger_egl.h"
 #endif
 
+#if defined(USE_GL)
+#   include "swaplogger_gl.h"
+#endif
+
 #if defined(USE_XSHM)
 #   include "swaplogger_xshm.h"
 #endif
@@ -66,9 +81,34 @@ static int roundResults = 1;
 static int showGeometry = 0;
 static char processName[256];
 static int resetRequested = 0;
+static int capturing = 1;
+static int controlEnabled = 0;
+static int recording = 0;
+static int heatmapEnabled = 0;
+static int rollupEnabled = 0;
+static int samplerEnabled = 0;
+static int gateEnabled = 0;
+static int backtraceEnabled = 0;
+#if defined(USE_GL)
+static struct GLProfileFrame glFrame;
+#endif
 static FILE* output = 0;
 static struct termios savedTermState;
 static pthread_mutex_t swapLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+
+/** Opens the output files and starts the threads; see startServices() */
+static pthread_t initThread;
+static int initThreadRunning = 0;
+
+__thread int swapLoggerThread = 0;
+
+/** Set in children forked from the traced process; they are not traced */
+static volatile int forkedChild = 0;
+
+/** Held while cleaning up at exit or after an interrupt */
+static pthread_mutex_t cleanupLock = PTHREAD_MUTEX_INITIALIZER;
+static int cleanedUp = 0;
 
 /**
  *  Statistics
@@ -93,15 +133,51 @@ static struct
     float movingAvgFps;
 } stats;
 
+/**
+ *  Startup metrics
+ *
+ *  Times are measured from the start of the process and are not affected
+ *  by resets.
+ */
+static struct
+{
+    /** Process start time */
+    int64_t processStart;
+
+    /** Time of the first counted swap */
+    int64_t firstSwap;
+
+    /** Time when stableFrames consecutive frames met stableDuration */
+    int64_t stable;
+
+    /** Number of consecutive frames required for stable rendering */
+    int stableFrames;
+
+    /** Maximum frame duration in milliseconds for a stable frame */
+    float stableDuration;
+
+    int stableRun;
+    int reported;
+} startup = { .stableFrames = 60, .stableDuration = 20.0f };
+
 static void printStatistics(void);
+static void printStartupMetrics(void);
+static void writeHeatmaps(void);
 
-static int64_t getTime(void)
+int64_t getTime(void)
 {
     struct timespec t;
     clock_gettime(CLOCK_REALTIME, &t);
     return (int64_t)(t.tv_nsec) + (t.tv_sec * 1000ULL * 1000ULL * 1000ULL);
 }
 
+int64_t getMonotonicTime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)(t.tv_nsec) + (t.tv_sec * 1000LL * 1000LL * 1000LL);
+}
+
 int getProcessName(char* name, int length)
 {
     int bytes;
@@ -139,24 +215,155 @@ int getProcessName(char* name, int length)
     return 1;
 }
 
-float milliseconds(uint64_t microseconds)
+/**
+ *  Control socket path: $SL_CONTROL_SOCKET or
+ *  $XDG_RUNTIME_DIR/swaplogger.<pid>.sock, falling back to /run/user/<uid>
+ */
+static void getControlSocketPath(char* path, int length)
 {
-    return microseconds / (1000.0f * 1000.0f);
+    if (getenv("SL_CONTROL_SOCKET"))
+    {
+        snprintf(path, length, "%s", getenv("SL_CONTROL_SOCKET"));
+    }
+    else if (getenv("XDG_RUNTIME_DIR"))
+    {
+        snprintf(path, length, "%s/swaplogger.%d.sock",
+                 getenv("XDG_RUNTIME_DIR"), (int)getpid());
+    }
+    else
+    {
+        snprintf(path, length, "/run/user/%d/swaplogger.%d.sock",
+                 (int)getuid(), (int)getpid());
+    }
+}
+
+/**
+ *  Determine the process start time from the start time in /proc/self/stat,
+ *  which is counted in clock ticks since boot.
+ */
+static int64_t getProcessStartTime(void)
+{
+    char stat[1024];
+    const char* fields;
+    unsigned long long startTicks;
+    struct timespec boot;
+    size_t len;
+    FILE* file;
+    int i;
+
+    file = fopen("/proc/self/stat", "r");
+    if (!file)
+    {
+        return 0;
+    }
+    len = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[len] = 0;
+
+    /* The command name may contain spaces, so skip past it first */
+    fields = strrchr(stat, ')');
+    if (!fields)
+    {
+        return 0;
+    }
+
+    /* Advance to the space in front of field 22, the start time */
+    for (i = 0; i < 20 && fields; i++)
+    {
+        fields = strchr(fields + 1, ' ');
+    }
+    if (!fields || sscanf(fields, " %llu", &startTicks) != 1)
+    {
+        return 0;
+    }
+
+    clock_gettime(CLOCK_BOOTTIME, &boot);
+    return getTime() - (boot.tv_sec * 1000LL * 1000LL * 1000LL + boot.tv_nsec) +
+           startTicks * (1000LL * 1000LL * 1000LL / sysconf(_SC_CLK_TCK));
 }
 
-static void printInfo(const char *info)
+float milliseconds(int64_t nanoseconds)
 {
+    return nanoseconds / (1000.0f * 1000.0f);
+}
+
+float framesPerSecond(int64_t duration)
+{
+    if (duration == 0)
+    {
+        return 0.0f;
+    }
+    return (1000.0f * 1000.0f * 1000.0f / duration);
+}
+
+void printInfo(const char* format, ...)
+{
+    char info[512];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(info, sizeof(info), format, args);
+    va_end(args);
+
+    /*
+     *  Frame lines buffered so far should come out first. If another
+     *  thread, or the caller, is busy with the formatter, leave it be.
+     */
+    if (!pthread_mutex_trylock(&swapLock))
+    {
+        formatFlush();
+        pthread_mutex_unlock(&swapLock);
+    }
     printf("INFO -- %.2f -- %s -- %s\n",
            milliseconds(getTime() - baseTime), processName, info);
 }
 
-static void cleanup(void)
+/** Let startServices() finish before tearing anything down */
+static void waitForServices(void)
+{
+    if (initThreadRunning)
+    {
+        pthread_join(initThread, NULL);
+        initThreadRunning = 0;
+    }
+}
+
+/** Print the final statistics and stop all threads; see cleanup() */
+static void finish(void)
 {
+    if (controlEnabled)
+    {
+        controlCleanup();
+    }
     if (interactive)
     {
         tcsetattr(0, TCSANOW, &savedTermState);
     }
+    /* The renderer may still be swapping, and the formatter isn't locked */
+    pthread_mutex_lock(&swapLock);
+    if (startup.firstSwap && !startup.reported)
+    {
+        printStartupMetrics();
+    }
     printStatistics();
+    pthread_mutex_unlock(&swapLock);
+
+    if (gateEnabled)
+    {
+        pthread_mutex_lock(&swapLock);
+        gateEvaluate(output, processName, milliseconds(getTime() - baseTime));
+        gateEnabled = 0;
+        pthread_mutex_unlock(&swapLock);
+    }
+
+    if (backtraceEnabled)
+    {
+        pthread_mutex_lock(&swapLock);
+        backtracePrint(output, processName, milliseconds(getTime() - baseTime));
+        backtraceCleanup();
+        backtraceEnabled = 0;
+        pthread_mutex_unlock(&swapLock);
+    }
 
 #if defined(USE_EGL)
     eglCleanup();
@@ -169,13 +376,95 @@ static void cleanup(void)
 #if defined(USE_XDAMAGE)
     damageCleanup();
 #endif /* USE_XDAMAGE */
+
+    if (recording)
+    {
+        recorderStop();
+        pthread_mutex_lock(&swapLock);
+        recorderCleanup();
+        pthread_mutex_unlock(&swapLock);
+    }
+
+    if (heatmapEnabled)
+    {
+        pthread_mutex_lock(&swapLock);
+        writeHeatmaps();
+        heatmapCleanup();
+        pthread_mutex_unlock(&swapLock);
+    }
+
+    if (samplerEnabled)
+    {
+        samplerCleanup();
+        samplerEnabled = 0;
+    }
+
+    if (rollupEnabled)
+    {
+        pthread_mutex_lock(&swapLock);
+        rollupCleanup();
+        rollupEnabled = 0;
+        pthread_mutex_unlock(&swapLock);
+    }
+}
+
+static void cleanup(void)
+{
+    /* Everything belongs to the parent, including its output files */
+    if (forkedChild)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&cleanupLock);
+    if (!cleanedUp)
+    {
+        cleanedUp = 1;
+        waitForServices();
+        finish();
+    }
+    pthread_mutex_unlock(&cleanupLock);
+}
+
+/**
+ *  Finish up after SIGINT in interactive mode. Runs on the control thread
+ *  because cleanup() takes locks and isn't async-signal-safe.
+ */
+void swapLoggerInterrupt(void)
+{
+    /* If exit() is already cleaning up, it is about to stop this thread */
+    if (pthread_mutex_trylock(&cleanupLock))
+    {
+        return;
+    }
+    if (!cleanedUp)
+    {
+        cleanedUp = 1;
+        waitForServices();
+        finish();
+    }
+    pthread_mutex_unlock(&cleanupLock);
+
+    /* The signal ends the process without flushing stdio */
+    pthread_mutex_lock(&swapLock);
+    formatFlush();
+    fflush(output);
+    fflush(stdout);
+    pthread_mutex_unlock(&swapLock);
+
+    signal(SIGINT, SIG_DFL);
+    raise(SIGINT);
 }
 
 static void handleInterrupt(int sig)
 {
-    signal(sig, SIG_DFL);
-    cleanup();
-    raise(sig);
+    if (!controlEnabled || !controlInterrupt())
+    {
+        /* Without the control thread, only restore the terminal */
+        tcsetattr(0, TCSANOW, &savedTermState);
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
 }
 
 static void handleReset(int sig)
@@ -184,6 +473,12 @@ static void handleReset(int sig)
     signal(sig, handleReset);
 }
 
+static void handleDumpRequest(int sig)
+{
+    recorderRequestDump();
+    signal(sig, handleDumpRequest);
+}
+
 static void reset(void)
 {
     frameCounter = 0;
@@ -192,9 +487,27 @@ static void reset(void)
     stats.maxFps = 0.0f;
     stats.avgDuration = 0.0f;
     stats.movingAvgFps = 0.0f;
+    phaseReset();
+
+#if defined(USE_GL)
+    glProfileReset();
+#endif /* USE_GL */
+
+#if defined(USE_XSHM)
+    xshmReset();
+#endif /* USE_XSHM */
+
+#if defined(USE_XDAMAGE)
+    damageReset();
+#endif /* USE_XDAMAGE */
 }
 
-void initSwapLogger(void)
+/**
+ *  Resolve the hooked functions and read the configuration. This runs
+ *  when the library is loaded and has no side effects, so it is cheap for
+ *  processes that inherit LD_PRELOAD but never render.
+ */
+static void configure(void)
 {
 #if defined(USE_EGL)
     if (!eglInit())
@@ -204,6 +517,14 @@ void initSwapLogger(void)
     }
 #endif /* USE_EGL */
 
+#if defined(USE_GL)
+    glProfileInit();
+    if (getenv("SL_GL_PROFILE"))
+    {
+        profile_GLCalls = atoi(getenv("SL_GL_PROFILE"));
+    }
+#endif /* USE_GL */
+
 #if defined(USE_XSHM)
     if (!xshmInit())
     {
@@ -213,15 +534,20 @@ void initSwapLogger(void)
 #endif /* USE_XSHM */
 
 #if defined(USE_XDAMAGE)
-    if (!damageInit())
+    if (getenv("SL_DAMAGE_WINDOWS"))
     {
-        printInfo("Unable to initialize X damage tracking");
+        track_XDamageWindows = atoi(getenv("SL_DAMAGE_WINDOWS"));
     }
 #endif /* USE_XDAMAGE */
 
     getProcessName(processName, sizeof(processName));
 
+    /* The output file is opened by startServices() */
     output = stdout;
+    if (!getenv("SL_OUTPUT"))
+    {
+        formatInit(output);
+    }
 
     if (getenv("SL_VERBOSE"))
     {
@@ -235,15 +561,6 @@ void initSwapLogger(void)
     {
         timestampCount = atoi(getenv("SL_PERIOD"));
     }
-    if (getenv("SL_OUTPUT"))
-    {
-        output = fopen(getenv("SL_OUTPUT"), "w");
-        if (!output)
-        {
-            perror("fopen");
-            output = stdout;
-        }
-    }
     if (getenv("SL_ROUND"))
     {
         roundResults = atoi(getenv("SL_ROUND"));
@@ -252,11 +569,88 @@ void initSwapLogger(void)
     {
         showGeometry = atoi(getenv("SL_SHOW_GEOMETRY"));
     }
+    if (getenv("SL_STABLE_FRAMES"))
+    {
+        startup.stableFrames = atoi(getenv("SL_STABLE_FRAMES"));
+    }
+    if (getenv("SL_STABLE_DURATION"))
+    {
+        startup.stableDuration = atof(getenv("SL_STABLE_DURATION"));
+    }
+    if (getenv("SL_HEATMAP_DIR"))
+    {
+        heatmapEnabled = 1;
+        heatmap_directory = getenv("SL_HEATMAP_DIR");
+    }
+    if (getenv("SL_HEATMAP_SCALE") && atoi(getenv("SL_HEATMAP_SCALE")) > 0)
+    {
+        heatmap_scale = atoi(getenv("SL_HEATMAP_SCALE"));
+    }
+    if (getenv("SL_HEATMAP_TOP"))
+    {
+        heatmap_topRegions = atoi(getenv("SL_HEATMAP_TOP"));
+    }
+    if (getenv("SL_ROLLUP_JANK"))
+    {
+        rollup_jankDuration = atof(getenv("SL_ROLLUP_JANK"));
+    }
+    if (getenv("SL_ROLLUP_FLUSH"))
+    {
+        rollup_flushInterval = atoi(getenv("SL_ROLLUP_FLUSH"));
+    }
+    if (getenv("SL_SAMPLE_INTERVAL"))
+    {
+        sampler_interval = atoi(getenv("SL_SAMPLE_INTERVAL"));
+    }
+    if (getenv("SL_GATE_WARMUP"))
+    {
+        gate_warmupFrames = atoi(getenv("SL_GATE_WARMUP"));
+    }
+    if (getenv("SL_BACKTRACE"))
+    {
+        backtrace_threshold = atof(getenv("SL_BACKTRACE"));
+    }
+    if (getenv("SL_BACKTRACE_SAMPLE"))
+    {
+        backtrace_sampleInterval = atoi(getenv("SL_BACKTRACE_SAMPLE"));
+    }
+    if (getenv("SL_BACKTRACE_TOP"))
+    {
+        backtrace_topStacks = atoi(getenv("SL_BACKTRACE_TOP"));
+    }
+    if (getenv("SL_RECORD_PRE"))
+    {
+        record_preSeconds = atof(getenv("SL_RECORD_PRE"));
+    }
+    if (getenv("SL_RECORD_POST"))
+    {
+        record_postSeconds = atof(getenv("SL_RECORD_POST"));
+    }
+    if (getenv("SL_RECORD_MAX_DURATION"))
+    {
+        record_maxDuration = atof(getenv("SL_RECORD_MAX_DURATION"));
+    }
+    if (getenv("SL_RECORD_MIN_FPS"))
+    {
+        record_minFps = atof(getenv("SL_RECORD_MIN_FPS"));
+    }
+    if (getenv("SL_RECORD_MAX_DUMPS"))
+    {
+        record_maxDumpsPerMinute = atoi(getenv("SL_RECORD_MAX_DUMPS"));
+    }
+    if (getenv("SL_RECORD_DIR"))
+    {
+        record_directory = getenv("SL_RECORD_DIR");
+    }
 #if defined(USE_XSHM)
     if (getenv("SL_COUNT_X"))
     {
         count_XSHMPutImage = atoi(getenv("SL_COUNT_X"));
     }
+    if (getenv("SL_XSHM_COMPLETION"))
+    {
+        force_ShmCompletion = atoi(getenv("SL_XSHM_COMPLETION"));
+    }
 #endif /* USE_XSHM */
 
 #if defined(USE_EGL)
@@ -273,16 +667,57 @@ void initSwapLogger(void)
     }
 #endif /* USE_XDAMAGE */
 
+    /* Info messages below are timestamped relative to this */
+    baseTime = getTime();
+
+    if (!startup.processStart)
+    {
+        startup.processStart = baseTime;
+    }
+    reset();
+    phaseInit(getenv("SL_PHASES"), baseTime);
+}
+
+/**
+ *  Open the output files and start the threads. This runs on its own
+ *  thread, started by the first hooked call, so that the first frame
+ *  doesn't wait for it. The feature flags checked by registerSwap() are
+ *  only set under swapLock once the feature is ready.
+ */
+static void* startServices(void* arg)
+{
+    int control = getenv("SL_CONTROL") && atoi(getenv("SL_CONTROL"));
+
+    if (getenv("SL_OUTPUT"))
+    {
+        FILE* file = fopen(getenv("SL_OUTPUT"), "w");
+
+        if (!file)
+        {
+            perror("fopen");
+            file = stdout;
+        }
+
+        /* Frames counted before this were kept in the format buffer */
+        pthread_mutex_lock(&swapLock);
+        output = file;
+        formatInit(output);
+        pthread_mutex_unlock(&swapLock);
+    }
+
+#if defined(USE_XDAMAGE)
+    if (!damageInit())
+    {
+        printInfo("Unable to initialize X damage tracking");
+    }
+#endif /* USE_XDAMAGE */
+
     if (interactive)
     {
-        int flags = fcntl(0, F_GETFL);
         struct termios term;
 
         signal(SIGINT, handleInterrupt);
 
-        flags |= O_NONBLOCK;
-        fcntl(0, F_SETFL, flags);
-
         tcgetattr(0, &term);
         savedTermState = term;
         term.c_lflag &= ~ICANON;
@@ -291,12 +726,169 @@ void initSwapLogger(void)
         setbuf(stdin, NULL);
     }
 
+    if (control || interactive)
+    {
+        char path[108] = "";
+
+        if (control)
+        {
+            getControlSocketPath(path, sizeof(path));
+        }
+        if (controlInit(control ? path : NULL, interactive))
+        {
+            controlEnabled = 1;
+            if (path[0])
+            {
+                printInfo("Control socket: %s", path);
+            }
+        }
+        else
+        {
+            printInfo("Unable to start control thread");
+        }
+    }
+
+    if (getenv("SL_ROLLUP"))
+    {
+        int enabled = rollupInit(getenv("SL_ROLLUP"), processName, baseTime);
+
+        if (!enabled)
+        {
+            printInfo("Unable to start rollups");
+        }
+        pthread_mutex_lock(&swapLock);
+        rollupEnabled = enabled;
+        pthread_mutex_unlock(&swapLock);
+    }
+
+    if (getenv("SL_GATE"))
+    {
+        static char verdictPath[256];
+        int enabled;
+
+        if (getenv("SL_GATE_FILE"))
+        {
+            snprintf(verdictPath, sizeof(verdictPath), "%s", getenv("SL_GATE_FILE"));
+        }
+        else
+        {
+            snprintf(verdictPath, sizeof(verdictPath), "swaplogger.%d.gate.json",
+                     (int)getpid());
+        }
+        enabled = gateInit(getenv("SL_GATE"), verdictPath);
+        if (!enabled)
+        {
+            printInfo("Unable to set up gate conditions");
+        }
+        pthread_mutex_lock(&swapLock);
+        gateEnabled = enabled;
+        pthread_mutex_unlock(&swapLock);
+    }
+
+    if (backtrace_threshold > 0)
+    {
+        int enabled = backtraceInit();
+
+        pthread_mutex_lock(&swapLock);
+        backtraceEnabled = enabled;
+        pthread_mutex_unlock(&swapLock);
+    }
+
+    if (getenv("SL_SAMPLE"))
+    {
+        samplerEnabled = samplerInit(getenv("SL_SAMPLE"), processName, baseTime);
+        if (!samplerEnabled)
+        {
+            printInfo("Unable to start system sampler");
+        }
+    }
+
+    if (getenv("SL_RECORD") && atoi(getenv("SL_RECORD")))
+    {
+        if (recorderInit(processName, baseTime))
+        {
+            signal(SIGUSR2, handleDumpRequest);
+            pthread_mutex_lock(&swapLock);
+            recording = 1;
+            pthread_mutex_unlock(&swapLock);
+        }
+        else
+        {
+            printInfo("Unable to start flight recorder");
+        }
+    }
+    printInfo("Swap logger initialized");
+    return NULL;
+}
+
+/** Runs once, on the first hooked call */
+static void startInitThread(void)
+{
+    /* A forked child only needs working hooks, it doesn't log anything */
+    if (forkedChild)
+    {
+        return;
+    }
+
+    /* Not left to the init thread, or an early reset would kill the process */
     signal(SIGUSR1, handleReset);
     atexit(cleanup);
+    if (pthread_create(&initThread, NULL, startServices, NULL))
+    {
+        startServices(NULL);
+    }
+    else
+    {
+        initThreadRunning = 1;
+    }
+}
 
-    baseTime = getTime();
-    reset();
-    printInfo("Swap logger initialized");
+void initSwapLogger(void)
+{
+    pthread_once(&initOnce, startInitThread);
+}
+
+/** Keep buffered output from being written out again by a forked child */
+static void prepareFork(void)
+{
+    pthread_mutex_lock(&swapLock);
+    formatFlush();
+    fflush(stdout);
+    if (output)
+    {
+        fflush(output);
+    }
+}
+
+static void parentAfterFork(void)
+{
+    pthread_mutex_unlock(&swapLock);
+}
+
+static void childAfterFork(void)
+{
+    forkedChild = 1;
+    pthread_mutex_unlock(&swapLock);
+}
+
+/**
+ *  Resolve the hooks and read the configuration when the library is
+ *  loaded. Files, sockets and threads wait for the first hooked call, so
+ *  processes that inherit LD_PRELOAD but never render, such as shell
+ *  helpers, don't touch the output files or start any threads.
+ */
+static void __attribute__((constructor)) loadSwapLogger(void)
+{
+    /* Set by the wrapper, which runs the program as a background job */
+    if (getenv("SL_DEFAULT_SIGINT"))
+    {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        unsetenv("SL_DEFAULT_SIGINT");
+    }
+    startup.processStart = getProcessStartTime();
+    pthread_atfork(prepareFork, parentAfterFork, childAfterFork);
+    configure();
 }
 
 static float estimateMovingAverageFps(void)
@@ -322,64 +914,221 @@ static float estimateMovingAverageFps(void)
     return (1000.0f * 1000.0f * 1000.0f * timestampCount) / duration;
 }
 
-static float instantaneousFps(uint64_t duration)
+/** Returns zero if no frames have been counted since start or reset */
+static int formatStatistics(char* line, size_t length)
 {
-    if (duration == 0)
+    int64_t time;
+
+    if (frameCounter == 0)
     {
-        return 0.0f;
+        return 0;
     }
-    return (1000.0f * 1000.0f * 1000.0f / duration);
+    time = timestamps[(frameCounter - 1) % MAX_TIMESTAMPS];
+    snprintf(line, length,
+             "STAT -- %.2f -- %s -- frame:%d ifps:%.2f min:%.2f max:%.2f apfs_%d:%.2f afps:%.2f",
+             milliseconds(time - baseTime), processName, frameCounter,
+             stats.instFps, stats.minFps, stats.maxFps, timestampCount,
+             stats.movingAvgFps, framesPerSecond(stats.avgDuration));
+    return 1;
 }
 
 static void printStatistics(void)
 {
-    int64_t time = timestamps[(MAX_TIMESTAMPS + frameCounter - 1) % MAX_TIMESTAMPS];
-    fprintf(output,
-            "STAT -- %.2f -- %s -- frame:%d ifps:%.2f min:%.2f max:%.2f apfs_%d:%.2f afps:%.2f\n",
-            milliseconds(time - baseTime), processName, frameCounter,
-            stats.instFps, stats.minFps, stats.maxFps, timestampCount,
-            stats.movingAvgFps, instantaneousFps(stats.avgDuration));
+    char line[512];
+
+    if (formatStatistics(line, sizeof(line)))
+    {
+        formatFlush();
+        fprintf(output, "%s\n", line);
+    }
+    phasePrint(output, processName, milliseconds(getTime() - baseTime));
+
+#if defined(USE_GL)
+    if (profile_GLCalls)
+    {
+        glProfilePrint(output, processName, milliseconds(getTime() - baseTime));
+    }
+#endif /* USE_GL */
+
+#if defined(USE_XSHM)
+    xshmPrintStatistics(output, processName, milliseconds(getTime() - baseTime));
+#endif /* USE_XSHM */
+
+#if defined(USE_XDAMAGE)
+    damagePrintWindows(output, processName, milliseconds(getTime() - baseTime));
+#endif /* USE_XDAMAGE */
+}
+
+static void writeHeatmaps(void)
+{
+    if (heatmapEnabled)
+    {
+        formatFlush();
+        heatmapWrite(output, processName, milliseconds(getTime() - baseTime));
+    }
+}
+
+static void resetAndReport(void)
+{
+    printStatistics();
+    if (gateEnabled)
+    {
+        gateEvaluate(output, processName, milliseconds(getTime() - baseTime));
+    }
+    writeHeatmaps();
+    reset();
+    formatFlush();
+    printInfo("Swap logger reset");
 }
 
-static void handleInput(void)
+static void reply(int fd, const char* format, ...)
 {
-    char cmd;
-    ssize_t len;
+    char message[512];
+    va_list args;
 
-    len = read(0, &cmd, sizeof(cmd));
+    va_start(args, format);
+    vsnprintf(message, sizeof(message) - 1, format, args);
+    va_end(args);
 
-    if (len <= 0 || len > sizeof(cmd))
+    if (fd < 0)
     {
-        return;
+        /* Called with swapLock held, so flush the frame lines here */
+        formatFlush();
+        printInfo("%s", message);
+    }
+    else
+    {
+        strcat(message, "\n");
+        send(fd, message, strlen(message), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+}
+
+static int parseToggle(const char* arg, int current)
+{
+    return arg[0] ? atoi(arg) : !current;
+}
+
+void swapLoggerCommand(const char* command, int replyFd)
+{
+    char name[32] = "";
+    char arg[32] = "";
+
+    sscanf(command, "%31s %31s", name, arg);
+
+    pthread_mutex_lock(&swapLock);
+
+    if (!strcmp(name, "reset"))
+    {
+        resetAndReport();
+        reply(replyFd, "ok");
     }
+    else if (!strcmp(name, "period"))
+    {
+        int period = atoi(arg);
+        if (period < 1 || period >= MAX_TIMESTAMPS)
+        {
+            reply(replyFd, "error: period must be between 1 and %d",
+                  MAX_TIMESTAMPS - 1);
+        }
+        else
+        {
+            timestampCount = period;
+            stats.movingAvgFps = estimateMovingAverageFps();
+            reply(replyFd, "Moving average period set to %d frames", period);
+        }
+    }
+    else if (!strcmp(name, "verbose"))
+    {
+        verbose = parseToggle(arg, verbose);
+        reply(replyFd, verbose ? "Quiet mode disabled" : "Quiet mode enabled");
+    }
+    else if (!strcmp(name, "round"))
+    {
+        roundResults = parseToggle(arg, roundResults);
+        reply(replyFd, roundResults ? "Result rounding enabled" : "Result rounding disabled");
+    }
+    else if (!strcmp(name, "geometry"))
+    {
+        showGeometry = parseToggle(arg, showGeometry);
+        reply(replyFd, showGeometry ? "Geometry output enabled" : "Geometry output disabled");
+    }
+    else if (!strcmp(name, "start"))
+    {
+        if (!capturing)
+        {
+            reset();
+            capturing = 1;
+        }
+        reply(replyFd, "Capture started");
+    }
+    else if (!strcmp(name, "stop"))
+    {
+        if (capturing)
+        {
+            capturing = 0;
+            printStatistics();
+        }
+        reply(replyFd, "Capture stopped");
+    }
+    else if (!strcmp(name, "stats"))
+    {
+        char line[512];
 
-    if (cmd == 'r')
+        if (replyFd < 0)
+        {
+            printStatistics();
+        }
+        else if (formatStatistics(line, sizeof(line)))
+        {
+            reply(replyFd, "%s", line);
+        }
+        else
+        {
+            reply(replyFd, "No frames since start or reset");
+        }
+    }
+    else if (!strcmp(name, "phase"))
     {
-        resetRequested = 1;
+        phaseRequest(arg[0] ? arg : NULL);
+        reply(replyFd, arg[0] ? "Phase %s started" : "Phase ended", arg);
     }
-    else if (cmd == 'h')
+    else if (!strcmp(name, "dump"))
     {
-        printInfo("Commands:");
-        printInfo("    r: Reset fps calculation");
-        printInfo("    q: Toggle quiet mode");
-        printInfo("    w: Toggle result rounding");
-        printInfo("    h: Show help");
+        if (recording)
+        {
+            recorderRequestDump();
+            reply(replyFd, "Flight recorder dump requested");
+        }
+        else
+        {
+            reply(replyFd, "error: flight recorder not enabled");
+        }
     }
-    else if (cmd == 'q')
+    else if (!strcmp(name, "help"))
     {
-        verbose = 1 - verbose;
-        printInfo(verbose ? "Quiet mode disabled" : "Quiet mode enabled");
+        reply(replyFd, "Commands (key in interactive mode):");
+        reply(replyFd, "    reset (r):           Reset fps calculation");
+        reply(replyFd, "    period N:            Set moving average period");
+        reply(replyFd, "    verbose [0|1] (q):   Toggle quiet mode");
+        reply(replyFd, "    round [0|1] (w):     Toggle result rounding");
+        reply(replyFd, "    geometry [0|1] (g):  Toggle swap geometry output");
+        reply(replyFd, "    start, stop:         Start or stop frame capture");
+        reply(replyFd, "    stats (s):           Show current statistics");
+        reply(replyFd, "    phase [NAME]:        Start a statistics phase, or end it");
+        reply(replyFd, "    dump:                Write a flight recorder dump");
+        reply(replyFd, "    help (h):            Show help");
     }
-    else if (cmd == 'w')
+    else
     {
-        roundResults = 1 - roundResults;
-        printInfo(roundResults ? "Result rounding enabled" : "Result rounding disabled");
+        reply(replyFd, "error: unknown command '%s'", name);
     }
+
+    pthread_mutex_unlock(&swapLock);
 }
 
 static void updateStatistics(int64_t duration)
 {
-    float fps = instantaneousFps(duration);
+    float fps = framesPerSecond(duration);
 
     stats.instFps = fps;
     if (frameCounter == 1)
@@ -405,33 +1154,151 @@ static void updateStatistics(int64_t duration)
     stats.movingAvgFps = estimateMovingAverageFps();
 }
 
+/**
+ *  Print the common line prefix "source -- time -- process"
+ */
+static void printPrefix(const char* source, int64_t time)
+{
+    formatPadded(source, 4);
+    formatString(" -- ");
+    formatFixed(milliseconds(time - baseTime), FORMAT_ROUNDED_DECIMALS);
+    formatString(" -- ");
+    formatString(processName);
+}
+
+static void printFrame(const char* source, int64_t time, int64_t duration)
+{
+    int decimals = roundResults ? FORMAT_ROUNDED_DECIMALS :
+                                  FORMAT_UNROUNDED_DECIMALS;
+
+    printPrefix(source, time);
+    formatString(" -- frame:");
+    formatInt(frameCounter);
+    formatString(" dur:");
+    formatFixed(milliseconds(duration), decimals);
+    formatString(" ifps:");
+    formatFixed(stats.instFps, decimals);
+    formatString(" min:");
+    formatFixed(stats.minFps, decimals);
+    formatString(" max:");
+    formatFixed(stats.maxFps, decimals);
+    formatString(" apfs_");
+    formatInt(timestampCount);
+    formatString(":");
+    formatFixed(stats.movingAvgFps, decimals);
+    formatString(" afps:");
+    formatFixed(framesPerSecond(stats.avgDuration), decimals);
+
+#if defined(USE_GL)
+    if (profile_GLCalls)
+    {
+        formatString(" draws:");
+        formatInt(glFrame.drawCalls);
+        formatString(" state:");
+        formatInt(glFrame.stateChanges);
+        formatString(" upload_bytes:");
+        formatInt64(glFrame.uploadBytes);
+        formatString(" stall:");
+        formatFixed(milliseconds(glFrame.stallTime), decimals);
+    }
+#endif /* USE_GL */
+    formatEndLine();
+}
+
+static void printStartupMetrics(void)
+{
+    formatString("STRT -- ");
+    formatFixed(milliseconds(getTime() - baseTime), FORMAT_ROUNDED_DECIMALS);
+    formatString(" -- ");
+    formatString(processName);
+    formatString(" -- first_swap:");
+    formatFixed(milliseconds(startup.firstSwap - startup.processStart),
+                FORMAT_ROUNDED_DECIMALS);
+    formatString(" stable_");
+    formatInt(startup.stableFrames);
+    formatString(":");
+    if (startup.stable)
+    {
+        formatFixed(milliseconds(startup.stable - startup.processStart),
+                    FORMAT_ROUNDED_DECIMALS);
+    }
+    else
+    {
+        formatString("-");
+    }
+    formatEndLine();
+    startup.reported = 1;
+}
+
+static void updateStartupMetrics(int64_t time, int64_t duration)
+{
+    if (!startup.firstSwap)
+    {
+        startup.firstSwap = time;
+    }
+    else if (duration > 0 && milliseconds(duration) <= startup.stableDuration)
+    {
+        if (++startup.stableRun >= startup.stableFrames)
+        {
+            startup.stable = time;
+            printStartupMetrics();
+        }
+    }
+    else
+    {
+        startup.stableRun = 0;
+    }
+}
+
 static void printGeometry(const char* source, int numRects,
                           const struct Rect* rects)
 {
     int64_t time = getTime();
-    static const char* format = "%-04s -- %.2f -- %s -- ";
     int i;
 
-    fprintf(output, format, source,
-            milliseconds(time - baseTime), processName);
+    printPrefix(source, time);
+    formatString(" -- ");
 
     for (i = 0; i < numRects; i++)
     {
-        fprintf(output, "x:%d y:%d w:%d h:%d%s",
-                rects[i].x, rects[i].y, rects[i].w, rects[i].h,
-                (i == numRects - 1) ? "\n" : "  ");
+        formatString("x:");
+        formatInt(rects[i].x);
+        formatString(" y:");
+        formatInt(rects[i].y);
+        formatString(" w:");
+        formatInt(rects[i].w);
+        formatString(" h:");
+        formatInt(rects[i].h);
+        if (i == numRects - 1)
+        {
+            formatEndLine();
+        }
+        else
+        {
+            formatString("  ");
+        }
     }
 }
 
-void registerSwap(const char* source, int numRects,
+void registerSwap(const char* source, uintptr_t surface, int numRects,
                   const struct Rect* rects)
 {
     int64_t time;
     int64_t duration = 0;
     int ignoreSwap = 0;
 
+    if (!capturing || forkedChild)
+    {
+        return;
+    }
+
     pthread_mutex_lock(&swapLock);
 
+    if (heatmapEnabled && numRects > 0 && rects)
+    {
+        heatmapAdd(source, surface, numRects, rects);
+    }
+
 #if defined(USE_EGL) && defined(USE_XDAMAGE)
     /* When both EGL or XSHM and X damage events are enabled, only count the
      * damage events as actual frames
@@ -451,25 +1318,53 @@ void registerSwap(const char* source, int numRects,
             duration = time - timestamps[(frameCounter - 1) % MAX_TIMESTAMPS];
         }
         updateStatistics(duration);
+
+        if (!startup.reported)
+        {
+            updateStartupMetrics(time, duration);
+        }
+        phaseUpdate(time, duration);
+
+        if (gateEnabled)
+        {
+            gateAddFrame(duration);
+        }
+
+        /* Only the application's own threads are worth a backtrace */
+        if (backtraceEnabled && !swapLoggerThread)
+        {
+            backtraceFrame(duration);
+        }
+
+#if defined(USE_GL)
+        if (profile_GLCalls)
+        {
+            glProfileFrame(&glFrame);
+        }
+#endif /* USE_GL */
+
+        if (rollupEnabled)
+        {
+            rollupAddFrame(time, duration);
+        }
+
+        if (recording)
+        {
+            recorderAddFrame(source, frameCounter, time, duration,
+                             stats.movingAvgFps);
+        }
     }
     else
     {
         time = getTime();
     }
 
-    if (verbose || (frameCounter % timestampCount) == 0)
+    /* The flight recorder writes frames only when triggered */
+    if (!recording && (verbose || (frameCounter % timestampCount) == 0))
     {
         if (!ignoreSwap)
         {
-            static const char* formatRounded =
-                "%-04s -- %.2f -- %s -- frame:%d dur:%.2f ifps:%.2f min:%.2f max:%.2f apfs_%d:%.2f afps:%.2f\n";
-            static const char* formatUnrounded =
-                "%-04s -- %.2f -- %s -- frame:%d dur:%f ifps:%f min:%f max:%f apfs_%d:%f afps:%f\n";
-            fprintf(output,
-                    roundResults ? formatRounded : formatUnrounded, source,
-                    milliseconds(time - baseTime), processName, frameCounter, milliseconds(duration),
-                    stats.instFps, stats.minFps, stats.maxFps, timestampCount,
-                    stats.movingAvgFps, instantaneousFps(stats.avgDuration));
+            printFrame(source, time, duration);
             if (showGeometry && numRects > 0 && rects)
             {
                 printGeometry(source, numRects, rects);
@@ -483,9 +1378,8 @@ void registerSwap(const char* source, int numRects,
             }
             else
             {
-                static const char* format = "%-04s -- %.2f -- %s\n";
-                fprintf(output, format, source,
-                        milliseconds(time - baseTime), processName);
+                printPrefix(source, time);
+                formatEndLine();
             }
         }
     }
@@ -495,17 +1389,10 @@ void registerSwap(const char* source, int numRects,
         frameCounter++;
     }
 
-    if (interactive)
-    {
-        handleInput();
-    }
-
     if (resetRequested)
     {
         resetRequested = 0;
-        printStatistics();
-        reset();
-        printInfo("Swap logger reset");
+        resetAndReport();
     }
 
     pthread_mutex_unlock(&swapLock);
@@ -23,13 +23,57 @@
 #ifndef SWAPLOGGER_H
 #define SWAPLOGGER_H
 
+#include <stdint.h>
+
+/**
+ *  The library is built with -fvisibility=hidden so that its internal
+ *  helpers cannot clash with symbols of the application. Only the
+ *  interposed entry points and the public markers API are exported.
+ */
+#define SWAPLOGGER_EXPORT __attribute__((visibility("default")))
+
 struct Rect
 {
     int x, y, w, h;
 };
 
+/** Wall clock time in nanoseconds, used for frame timestamps */
+int64_t getTime(void);
+
+/** Monotonic time in nanoseconds, used for measuring intervals */
+int64_t getMonotonicTime(void);
+
+/** Convert nanoseconds to milliseconds */
+float milliseconds(int64_t nanoseconds);
+
+/** Frame rate matching a frame duration in nanoseconds, or zero */
+float framesPerSecond(int64_t duration);
+
+/**
+ *  Print an "INFO -- time -- process -- message" line to stdout. Can be
+ *  called from any thread.
+ */
+void printInfo(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+/** Set on the swap logger's own threads that report frames */
+extern __thread int swapLoggerThread;
+
 void initSwapLogger(void);
-void registerSwap(const char* source, int numRects,
+
+/**
+ *  Register a frame from the given source. The surface is the EGLSurface
+ *  or X drawable the frame was rendered to, or zero if it isn't known.
+ */
+void registerSwap(const char* source, uintptr_t surface, int numRects,
                   const struct Rect* rects);
 
+/**
+ *  Run a runtime control command such as "reset" or "period 32". Replies
+ *  are written to replyFd, or printed as info messages if replyFd is -1.
+ */
+void swapLoggerCommand(const char* command, int replyFd);
+
+/** Print the final results and terminate after an interrupt */
+void swapLoggerInterrupt(void);
+
 #endif /* SWAPLOGGER_H */
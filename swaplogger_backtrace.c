@@ -0,0 +1,413 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+/* dl_iterate_phdr */
+#define _GNU_SOURCE
+
+#include "swaplogger.h"
+#include "swaplogger_backtrace.h"
+
+#include <sys/syscall.h>
+#include <link.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <execinfo.h>
+
+#define MAX_DEPTH           32
+#define MAX_FRAME_SAMPLES   256
+#define MAX_STACKS          1024
+#define MAX_MAPPINGS        1024
+
+/* Older C libraries don't name the thread id field of struct sigevent */
+#ifndef sigev_notify_thread_id
+#   define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+float backtrace_threshold = 0.0f;
+int backtrace_sampleInterval = 0;
+int backtrace_topStacks = 10;
+
+enum StackKind
+{
+    STACK_SWAP,
+    STACK_SAMPLE,
+};
+
+struct Stack
+{
+    int depth;
+    void* frames[MAX_DEPTH];
+};
+
+/** Distinct stacks and the number of times each was seen */
+static struct StackCount
+{
+    uint32_t hash;
+    enum StackKind kind;
+    int count;
+    struct Stack stack;
+} *stacks;
+
+static int stackCount = 0;
+static int droppedStacks = 0;
+static int slowFrames = 0;
+
+/** Timer signal samples taken since the previous frame */
+static struct Stack samples[MAX_FRAME_SAMPLES];
+static volatile sig_atomic_t sampleCount = 0;
+static int droppedSamples = 0;
+
+static int sampling = 0;
+static pid_t sampledThread = 0;
+
+/** Code segment of the swap logger, whose frames are left out of stacks */
+static uintptr_t selfStart = 0;
+static uintptr_t selfEnd = 0;
+static timer_t sampleTimer;
+static struct sigaction savedAction;
+
+static int findSelf(struct dl_phdr_info* info, size_t size, void* data)
+{
+    uintptr_t address = (uintptr_t)data;
+    int i;
+
+    for (i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr)* segment = &info->dlpi_phdr[i];
+        uintptr_t start = info->dlpi_addr + segment->p_vaddr;
+
+        if (segment->p_type == PT_LOAD && (segment->p_flags & PF_X) &&
+            address >= start && address < start + segment->p_memsz)
+        {
+            selfStart = start;
+            selfEnd = start + segment->p_memsz;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int backtraceInit(void)
+{
+    void* frame;
+
+    stacks = calloc(MAX_STACKS, sizeof(*stacks));
+    if (!stacks)
+    {
+        printInfo("Unable to allocate backtrace table");
+        return 0;
+    }
+
+    /* The first call loads the unwinder, which isn't safe in a signal handler */
+    backtrace(&frame, 1);
+
+    dl_iterate_phdr(findSelf, (void*)(uintptr_t)backtraceInit);
+    return 1;
+}
+
+static void handleSample(int sig)
+{
+    int n = sampleCount;
+
+    (void)sig;
+    if (syscall(SYS_gettid) != sampledThread)
+    {
+        return;
+    }
+    if (n >= MAX_FRAME_SAMPLES)
+    {
+        return;
+    }
+    samples[n].depth = backtrace(samples[n].frames, MAX_DEPTH);
+    sampleCount = n + 1;
+}
+
+/**
+ *  Sample the thread that swaps with a per-thread timer, so that samples
+ *  are taken whether the thread is running or blocked.
+ */
+static void startSampling(void)
+{
+    struct sigaction action;
+    struct sigevent event;
+    struct itimerspec interval;
+
+    sampledThread = syscall(SYS_gettid);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &savedAction) < 0)
+    {
+        perror("sigaction");
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = sampledThread;
+    if (timer_create(CLOCK_MONOTONIC, &event, &sampleTimer) < 0)
+    {
+        perror("timer_create");
+        sigaction(SIGPROF, &savedAction, NULL);
+        return;
+    }
+
+    interval.it_interval.tv_sec = backtrace_sampleInterval / 1000;
+    interval.it_interval.tv_nsec = (backtrace_sampleInterval % 1000) * 1000L * 1000L;
+    interval.it_value = interval.it_interval;
+    timer_settime(sampleTimer, 0, &interval, NULL);
+    sampling = 1;
+}
+
+static uint32_t hashStack(enum StackKind kind, const struct Stack* s)
+{
+    uint32_t hash = 2166136261u ^ kind;
+    int i;
+
+    for (i = 0; i < s->depth; i++)
+    {
+        hash = (hash ^ (uint32_t)(uintptr_t)s->frames[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void countStack(enum StackKind kind, const struct Stack* s)
+{
+    uint32_t hash = hashStack(kind, s);
+    int i;
+
+    for (i = 0; i < stackCount; i++)
+    {
+        if (stacks[i].hash == hash && stacks[i].kind == kind &&
+            stacks[i].stack.depth == s->depth &&
+            !memcmp(stacks[i].stack.frames, s->frames, s->depth * sizeof(void*)))
+        {
+            stacks[i].count++;
+            return;
+        }
+    }
+
+    if (stackCount >= MAX_STACKS)
+    {
+        droppedStacks++;
+        return;
+    }
+    stacks[stackCount].hash = hash;
+    stacks[stackCount].kind = kind;
+    stacks[stackCount].count = 1;
+    stacks[stackCount].stack = *s;
+    stackCount++;
+}
+
+/** Drop the n innermost frames */
+static void dropFrames(struct Stack* s, int n)
+{
+    if (s->depth <= n)
+    {
+        s->depth = 0;
+        return;
+    }
+    s->depth -= n;
+    memmove(s->frames, s->frames + n, s->depth * sizeof(void*));
+}
+
+/**
+ *  Drop the innermost frames that are inside the swap logger, such as this
+ *  module, registerSwap() and the interposed eglSwapBuffers().
+ */
+static void dropOwnFrames(struct Stack* s)
+{
+    int n = 0;
+
+    while (n < s->depth && (uintptr_t)s->frames[n] >= selfStart &&
+           (uintptr_t)s->frames[n] < selfEnd)
+    {
+        n++;
+    }
+    dropFrames(s, n);
+}
+
+void backtraceFrame(int64_t duration)
+{
+    struct Stack stack;
+    int n, i;
+
+    if (backtrace_sampleInterval > 0 && !sampling && !sampledThread)
+    {
+        startSampling();
+    }
+
+    if (duration <= backtrace_threshold * 1000.0f * 1000.0f)
+    {
+        sampleCount = 0;
+        return;
+    }
+
+    slowFrames++;
+
+    stack.depth = backtrace(stack.frames, MAX_DEPTH);
+    dropOwnFrames(&stack);
+    countStack(STACK_SWAP, &stack);
+
+    n = sampleCount;
+    if (n >= MAX_FRAME_SAMPLES)
+    {
+        droppedSamples++;
+    }
+    for (i = 0; i < n; i++)
+    {
+        /* Leave out the signal handler and the signal return trampoline */
+        dropFrames(&samples[i], 2);
+        dropOwnFrames(&samples[i]);
+        countStack(STACK_SAMPLE, &samples[i]);
+    }
+    sampleCount = 0;
+}
+
+static struct Mapping
+{
+    uintptr_t start;
+    uintptr_t end;
+    uintptr_t offset;
+    char path[256];
+} *mappings;
+
+static int mappingCount = 0;
+
+/** Read the executable mappings of the process for address translation */
+static void readMappings(void)
+{
+    char line[512];
+    char perms[8];
+    FILE* file;
+
+    mappingCount = 0;
+    mappings = calloc(MAX_MAPPINGS, sizeof(*mappings));
+    file = fopen("/proc/self/maps", "r");
+    if (!mappings || !file)
+    {
+        if (file)
+        {
+            fclose(file);
+        }
+        return;
+    }
+
+    while (mappingCount < MAX_MAPPINGS && fgets(line, sizeof(line), file))
+    {
+        struct Mapping* m = &mappings[mappingCount];
+        unsigned long start, end, offset;
+
+        m->path[0] = 0;
+        if (sscanf(line, "%lx-%lx %7s %lx %*s %*s %255[^\n]",
+                   &start, &end, perms, &offset, m->path) < 4 ||
+            perms[2] != 'x')
+        {
+            continue;
+        }
+        m->start = start;
+        m->end = end;
+        m->offset = offset;
+        mappingCount++;
+    }
+    fclose(file);
+}
+
+static void printAddress(FILE* output, void* address)
+{
+    uintptr_t a = (uintptr_t)address;
+    int i;
+
+    for (i = 0; i < mappingCount; i++)
+    {
+        if (a >= mappings[i].start && a < mappings[i].end && mappings[i].path[0])
+        {
+            fprintf(output, " %s+0x%lx", mappings[i].path,
+                    (unsigned long)(a - mappings[i].start + mappings[i].offset));
+            return;
+        }
+    }
+    fprintf(output, " %p", address);
+}
+
+static int compareCounts(const void* a, const void* b)
+{
+    return ((const struct StackCount*)b)->count - ((const struct StackCount*)a)->count;
+}
+
+void backtracePrint(FILE* output, const char* processName, float time)
+{
+    int i, j;
+
+    if (!stacks)
+    {
+        return;
+    }
+
+    fprintf(output, "BTRC -- %.2f -- %s -- slow_frames:%d stacks:%d dropped_stacks:%d "
+            "dropped_samples:%d\n", time, processName, slowFrames, stackCount,
+            droppedStacks, droppedSamples);
+
+    qsort(stacks, stackCount, sizeof(*stacks), compareCounts);
+    readMappings();
+
+    for (i = 0; i < stackCount && i < backtrace_topStacks; i++)
+    {
+        fprintf(output, "BTRC -- %.2f -- %s -- kind:%s count:%d stack:",
+                time, processName, stacks[i].kind == STACK_SWAP ? "swap" : "sample",
+                stacks[i].count);
+        for (j = 0; j < stacks[i].stack.depth; j++)
+        {
+            printAddress(output, stacks[i].stack.frames[j]);
+        }
+        fprintf(output, "\n");
+    }
+
+    free(mappings);
+    mappings = NULL;
+}
+
+void backtraceCleanup(void)
+{
+    if (sampling)
+    {
+        timer_delete(sampleTimer);
+        sampledThread = -1;
+        sampling = 0;
+
+        /* A signal may still be pending, so only hand back a real handler */
+        if (savedAction.sa_handler != SIG_DFL)
+        {
+            sigaction(SIGPROF, &savedAction, NULL);
+        }
+    }
+    free(stacks);
+    stacks = NULL;
+}
@@ -0,0 +1,52 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_BACKTRACE_H
+#define SWAPLOGGER_BACKTRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ *  Backtraces of slow frames
+ *
+ *  When a frame takes longer than backtrace_threshold milliseconds, the
+ *  stack of the swapping thread is captured. If backtrace_sampleInterval
+ *  is set, the swapping thread is also sampled with a timer signal while
+ *  frames are rendered and the samples of slow frames are kept. Identical
+ *  stacks are counted together and printed as module+offset addresses for
+ *  offline symbolization. Frames inside the swap logger itself, such as the
+ *  interposed swap call, are left out.
+ */
+int backtraceInit(void);
+void backtraceCleanup(void);
+
+/** Called for every counted frame with swapLock held */
+void backtraceFrame(int64_t duration);
+
+void backtracePrint(FILE* output, const char* processName, float time);
+
+extern float backtrace_threshold;
+extern int backtrace_sampleInterval;
+extern int backtrace_topStacks;
+
+#endif /* SWAPLOGGER_BACKTRACE_H */
@@ -0,0 +1,396 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+/* pipe2 */
+#define _GNU_SOURCE
+
+#include "swaplogger.h"
+#include "swaplogger_control.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+
+#define MAX_CLIENTS     4
+#define MAX_LINE        256
+
+/* Bytes written to the wake pipe */
+#define WAKE_STOP       0
+#define WAKE_INTERRUPT  'i'
+
+static void *controlThread(void *data);
+
+static struct
+{
+    int listenFd;
+    int wakeFd[2];
+    int useStdin;
+    int running;
+    pid_t ownerPid;
+    char socketPath[108];
+
+    struct
+    {
+        int fd;
+        size_t length;
+        char line[MAX_LINE];
+    } clients[MAX_CLIENTS];
+
+    pthread_t thread;
+} control;
+
+/** Keys accepted on stdin and the commands they map to */
+static const struct
+{
+    char key;
+    const char* command;
+} keyCommands[] =
+{
+    { 'r', "reset" },
+    { 'q', "verbose" },
+    { 'w', "round" },
+    { 'g', "geometry" },
+    { 's', "stats" },
+    { 'h', "help" },
+};
+
+/**
+ *  Remove a socket left behind at path, e.g. by a process that was killed.
+ *  Refuses to remove anything that is not a socket.
+ */
+static int removeStaleSocket(const char* path)
+{
+    struct stat st;
+
+    if (lstat(path, &st) < 0)
+    {
+        return errno == ENOENT;
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        printInfo("Control socket path exists and is not a socket: %s", path);
+        return 0;
+    }
+    return unlink(path) == 0;
+}
+
+int controlInit(const char* socketPath, int useStdin)
+{
+    int i;
+
+    memset(&control, 0, sizeof(control));
+    control.listenFd = -1;
+    control.wakeFd[0] = control.wakeFd[1] = -1;
+    control.useStdin = useStdin;
+    control.ownerPid = getpid();
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        control.clients[i].fd = -1;
+    }
+
+    if (pipe2(control.wakeFd, O_CLOEXEC) < 0)
+    {
+        perror("pipe2");
+        goto out;
+    }
+
+    if (socketPath)
+    {
+        struct sockaddr_un addr;
+
+        if (strlen(socketPath) >= sizeof(addr.sun_path))
+        {
+            printInfo("Control socket path too long: %s", socketPath);
+            goto out;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, socketPath);
+
+        control.listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (control.listenFd < 0)
+        {
+            perror("socket");
+            goto out;
+        }
+
+        if (!removeStaleSocket(socketPath))
+        {
+            goto out;
+        }
+        if (bind(control.listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            listen(control.listenFd, MAX_CLIENTS) < 0)
+        {
+            perror("bind");
+            goto out;
+        }
+        strcpy(control.socketPath, socketPath);
+    }
+
+    if (pthread_create(&control.thread, NULL, controlThread, NULL))
+    {
+        goto out;
+    }
+    control.running = 1;
+    return 1;
+
+out:
+    controlCleanup();
+    return 0;
+}
+
+void controlCleanup(void)
+{
+    int i;
+
+    /* The thread, socket and wake pipe belong to the process that started them */
+    if (control.ownerPid != getpid())
+    {
+        return;
+    }
+
+    if (control.running)
+    {
+        const char stop = WAKE_STOP;
+
+        /* After an interrupt this runs on the control thread itself */
+        if (!pthread_equal(pthread_self(), control.thread))
+        {
+            if (write(control.wakeFd[1], &stop, 1) < 0)
+            {
+                perror("write");
+            }
+            pthread_join(control.thread, NULL);
+        }
+        control.running = 0;
+    }
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (control.clients[i].fd >= 0)
+        {
+            close(control.clients[i].fd);
+            control.clients[i].fd = -1;
+        }
+    }
+
+    if (control.listenFd >= 0)
+    {
+        close(control.listenFd);
+        control.listenFd = -1;
+    }
+
+    if (control.socketPath[0])
+    {
+        unlink(control.socketPath);
+        control.socketPath[0] = 0;
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        if (control.wakeFd[i] >= 0)
+        {
+            close(control.wakeFd[i]);
+            control.wakeFd[i] = -1;
+        }
+    }
+}
+
+int controlInterrupt(void)
+{
+    const char interrupt = WAKE_INTERRUPT;
+
+    if (!control.running || control.ownerPid != getpid())
+    {
+        return 0;
+    }
+    return write(control.wakeFd[1], &interrupt, 1) == 1;
+}
+
+static void acceptClient(void)
+{
+    int fd = accept(control.listenFd, NULL, NULL);
+    int i;
+
+    if (fd < 0)
+    {
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (control.clients[i].fd < 0)
+        {
+            control.clients[i].fd = fd;
+            control.clients[i].length = 0;
+            return;
+        }
+    }
+    close(fd);
+}
+
+/**
+ *  Read from a client and run every complete line as a command. Returns
+ *  zero when the client has disconnected.
+ */
+static int readClient(int client)
+{
+    char data[MAX_LINE];
+    ssize_t len = read(control.clients[client].fd, data, sizeof(data));
+    ssize_t i;
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        char* line = control.clients[client].line;
+        size_t* length = &control.clients[client].length;
+
+        if (data[i] == '\n' || data[i] == '\r')
+        {
+            line[*length] = 0;
+            if (*length)
+            {
+                swapLoggerCommand(line, control.clients[client].fd);
+            }
+            *length = 0;
+        }
+        else if (*length < MAX_LINE - 1)
+        {
+            line[(*length)++] = data[i];
+        }
+    }
+    return 1;
+}
+
+static int readStdin(void)
+{
+    char key;
+    ssize_t len = read(0, &key, sizeof(key));
+    int i;
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < sizeof(keyCommands) / sizeof(keyCommands[0]); i++)
+    {
+        if (keyCommands[i].key == key)
+        {
+            swapLoggerCommand(keyCommands[i].command, -1);
+            break;
+        }
+    }
+    return 1;
+}
+
+void *controlThread(void* data)
+{
+    (void)data;
+
+    while (1)
+    {
+        struct pollfd fds[3 + MAX_CLIENTS];
+        int clientIndex[3 + MAX_CLIENTS];
+        int n = 0;
+        int i;
+
+        fds[n].fd = control.wakeFd[0];
+        fds[n++].events = POLLIN;
+        if (control.listenFd >= 0)
+        {
+            fds[n].fd = control.listenFd;
+            fds[n++].events = POLLIN;
+        }
+        if (control.useStdin)
+        {
+            fds[n].fd = 0;
+            fds[n++].events = POLLIN;
+        }
+        for (i = 0; i < MAX_CLIENTS; i++)
+        {
+            if (control.clients[i].fd >= 0)
+            {
+                clientIndex[n] = i;
+                fds[n].fd = control.clients[i].fd;
+                fds[n++].events = POLLIN;
+            }
+        }
+
+        if (poll(fds, n, -1) < 0)
+        {
+            continue;
+        }
+
+        if (fds[0].revents)
+        {
+            char wake = WAKE_STOP;
+
+            if (read(control.wakeFd[0], &wake, 1) == 1 && wake == WAKE_INTERRUPT)
+            {
+                swapLoggerInterrupt();
+                continue;
+            }
+            break;
+        }
+
+        for (i = 1; i < n; i++)
+        {
+            if (!fds[i].revents)
+            {
+                continue;
+            }
+            if (fds[i].fd == control.listenFd)
+            {
+                acceptClient();
+            }
+            else if (fds[i].fd == 0)
+            {
+                if (!readStdin())
+                {
+                    control.useStdin = 0;
+                }
+            }
+            else if (!readClient(clientIndex[i]))
+            {
+                close(control.clients[clientIndex[i]].fd);
+                control.clients[clientIndex[i]].fd = -1;
+            }
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,44 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_CONTROL_H
+#define SWAPLOGGER_CONTROL_H
+
+/**
+ *  Start the control thread. Commands are read as text lines from a Unix
+ *  socket at socketPath (if not NULL) and as single key presses from stdin
+ *  (if useStdin is set). Each command is passed to swapLoggerCommand().
+ *
+ *  An existing socket at socketPath is replaced, any other kind of file is
+ *  left alone and controlInit() fails. controlCleanup() does nothing in a
+ *  forked child, so that it doesn't remove the parent's socket.
+ */
+int controlInit(const char* socketPath, int useStdin);
+void controlCleanup(void);
+
+/**
+ *  Have the control thread call swapLoggerInterrupt(). Async-signal-safe.
+ *  Returns zero if the control thread isn't running.
+ */
+int controlInterrupt(void);
+
+#endif /* SWAPLOGGER_CONTROL_H */
@@ -23,6 +23,10 @@
 #include "swaplogger.h"
 #include "swaplogger_egl.h"
 
+#if defined(USE_GL)
+#   include "swaplogger_gl.h"
+#endif
+
 #include <EGL/egl.h>
 
 #include <stdio.h>
@@ -71,12 +75,10 @@ void eglCleanup(void)
     dlclose(eglLibrary);
 }
 
-EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+SWAPLOGGER_EXPORT EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
 {
-    if (!real_eglSwapBuffers)
-    {
-        initSwapLogger();
-    }
+    /* Starts the logging threads on the first call */
+    initSwapLogger();
 
     if (count_eglSwapBuffers)
     {
@@ -84,7 +86,7 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
         eglQuerySurface(dpy, surface, EGL_WIDTH, &rect.w);
         eglQuerySurface(dpy, surface, EGL_HEIGHT, &rect.h);
 
-        registerSwap("EGL", 1, &rect);
+        registerSwap("EGL", (uintptr_t)surface, 1, &rect);
     }
 
     return real_eglSwapBuffers(dpy, surface);
@@ -95,20 +97,17 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffersRegion2(EGLDisplay dpy, EGLSurface s
 {
     if (count_eglSwapBuffers)
     {
-        registerSwap("EGL", count, (const struct Rect*)rects);
+        registerSwap("EGL", (uintptr_t)surface, count, (const struct Rect*)rects);
     }
 
     return real_eglSwapBuffersRegion2(dpy, surface, count, rects);
 }
 
-EGLAPI EGLFunction EGLAPIENTRY eglGetProcAddress(const char* procName)
+SWAPLOGGER_EXPORT EGLAPI EGLFunction EGLAPIENTRY eglGetProcAddress(const char* procName)
 {
     EGLFunction f;
 
-    if (!real_eglGetProcAddress)
-    {
-        initSwapLogger();
-    }
+    initSwapLogger();
 
     f = real_eglGetProcAddress(procName);
 
@@ -118,5 +117,9 @@ EGLAPI EGLFunction EGLAPIENTRY eglGetProcAddress(const char* procName)
         f = (EGLFunction)eglSwapBuffersRegion2;
     }
 
+#if defined(USE_GL)
+    f = (EGLFunction)glProfileGetProcAddress(procName, (GLProfileFunction)f);
+#endif /* USE_GL */
+
     return f;
 }
@@ -0,0 +1,225 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger_format.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+
+#define BUFFER_SIZE     (64 * 1024)
+
+/* Longest output of a single formatInt() or formatFixed() call */
+#define MAX_FIELD       64
+
+static const int64_t decimalScale[] =
+{
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL
+};
+
+static struct
+{
+    FILE* stream;
+    int fd;
+    int lineBuffered;
+    size_t length;
+    char data[BUFFER_SIZE];
+} buffer = { .fd = -1 };
+
+void formatInit(FILE* stream)
+{
+    buffer.stream = stream;
+    buffer.fd = fileno(stream);
+    buffer.lineBuffered = isatty(buffer.fd);
+}
+
+void formatFlush(void)
+{
+    size_t written = 0;
+
+    /* Until formatInit() there is nowhere to write to */
+    if (!buffer.length || buffer.fd < 0)
+    {
+        return;
+    }
+
+    /* Anything printed through stdio must come out first */
+    fflush(buffer.stream);
+
+    while (written < buffer.length)
+    {
+        ssize_t n = write(buffer.fd, buffer.data + written,
+                          buffer.length - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        written += n;
+    }
+    buffer.length = 0;
+}
+
+static char* reserve(size_t bytes)
+{
+    if (buffer.length + bytes > BUFFER_SIZE)
+    {
+        formatFlush();
+
+        /* Still no output stream, so drop what was kept so far */
+        if (buffer.length + bytes > BUFFER_SIZE)
+        {
+            buffer.length = 0;
+        }
+    }
+    return buffer.data + buffer.length;
+}
+
+void formatString(const char* s)
+{
+    size_t len = strlen(s);
+
+    if (len > BUFFER_SIZE)
+    {
+        formatFlush();
+        if (buffer.stream)
+        {
+            fputs(s, buffer.stream);
+        }
+        return;
+    }
+    memcpy(reserve(len), s, len);
+    buffer.length += len;
+}
+
+void formatPadded(const char* s, int width)
+{
+    int len = strlen(s);
+
+    formatString(s);
+    if (len < width)
+    {
+        memset(reserve(width - len), ' ', width - len);
+        buffer.length += width - len;
+    }
+}
+
+static size_t formatDigits(char* out, uint64_t value, int minDigits)
+{
+    char digits[24];
+    size_t n = 0;
+    size_t i;
+
+    do
+    {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value || n < minDigits);
+
+    for (i = 0; i < n; i++)
+    {
+        out[i] = digits[n - i - 1];
+    }
+    return n;
+}
+
+void formatInt(int value)
+{
+    formatInt64(value);
+}
+
+void formatInt64(int64_t value)
+{
+    char* out = reserve(MAX_FIELD);
+    char* start = out;
+    uint64_t magnitude = value;
+
+    if (value < 0)
+    {
+        *out++ = '-';
+        magnitude = -(uint64_t)value;
+    }
+    out += formatDigits(out, magnitude, 1);
+    buffer.length += out - start;
+}
+
+/**
+ *  Equivalent to printf("%.*f", decimals, value) for 0 <= decimals <= 6.
+ *
+ *  A float has a 24 bit mantissa and 10^6 needs 14 bits, so scaling the
+ *  value in double precision is exact. Rounding the scaled value to the
+ *  nearest integer, ties to even, then gives the same digits as printf.
+ */
+void formatFixed(float value, int decimals)
+{
+    char* out = reserve(MAX_FIELD);
+    char* start = out;
+    double scaled = (double)value * decimalScale[decimals];
+    uint64_t n;
+    double remainder;
+
+    if (scaled < 0)
+    {
+        scaled = -scaled;
+    }
+    if (!isfinite(scaled) || scaled >= 9.0e18)
+    {
+        buffer.length += snprintf(out, MAX_FIELD, "%.*f", decimals, value);
+        return;
+    }
+
+    n = (uint64_t)scaled;
+    remainder = scaled - n;
+    if (remainder > 0.5 || (remainder == 0.5 && (n & 1)))
+    {
+        n++;
+    }
+
+    if (signbit(value))
+    {
+        *out++ = '-';
+    }
+    out += formatDigits(out, n / decimalScale[decimals], 1);
+    if (decimals)
+    {
+        *out++ = '.';
+        out += formatDigits(out, n % decimalScale[decimals], decimals);
+    }
+    buffer.length += out - start;
+}
+
+void formatEndLine(void)
+{
+    *reserve(1) = '\n';
+    buffer.length++;
+
+    if (buffer.lineBuffered)
+    {
+        formatFlush();
+    }
+}
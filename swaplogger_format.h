@@ -0,0 +1,55 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_FORMAT_H
+#define SWAPLOGGER_FORMAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ *  Number of decimals used for rounded and unrounded output. The unrounded
+ *  precision matches the default precision of printf's %f.
+ */
+#define FORMAT_ROUNDED_DECIMALS     2
+#define FORMAT_UNROUNDED_DECIMALS   6
+
+/**
+ *  Fast text formatter for the per-frame output
+ *
+ *  Text is collected into a fixed size buffer and written to the output
+ *  stream's file descriptor with write() once the buffer fills up. If the
+ *  output is a terminal, every line is written out immediately. Text
+ *  formatted before formatInit() is kept until the stream is known. The
+ *  caller must serialize access (registerSwap() holds swapLock).
+ */
+void formatInit(FILE* stream);
+void formatFlush(void);
+
+void formatString(const char* s);
+void formatPadded(const char* s, int width);
+void formatInt(int value);
+void formatInt64(int64_t value);
+void formatFixed(float value, int decimals);
+void formatEndLine(void);
+
+#endif /* SWAPLOGGER_FORMAT_H */
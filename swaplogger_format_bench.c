@@ -0,0 +1,159 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+/**
+ *  Micro-benchmark of the frame line formatter
+ *
+ *  Formats the same frame lines once with fprintf() and once with the
+ *  swaplogger_format.h functions, checks that both produce identical output
+ *  and prints the time taken per line. Build with "make bench".
+ *
+ *  Usage: swaplogger_format_bench [lines]
+ */
+#include "swaplogger_format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define DEFAULT_LINES   1000000
+
+static double getSeconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/** Field values of one frame line, varied per line like real frame times */
+static void makeValues(int line, float* values)
+{
+    int i;
+
+    for (i = 0; i < 7; i++)
+    {
+        values[i] = line * 0.01667f + i * 3.1f;
+    }
+}
+
+static double benchPrintf(FILE* file, int lines)
+{
+    double start = getSeconds();
+    float v[7];
+    int i;
+
+    for (i = 0; i < lines; i++)
+    {
+        makeValues(i, v);
+        fprintf(file, "%-4s -- %.2f -- %s -- frame:%d dur:%.2f ifps:%.2f "
+                "min:%.2f max:%.2f apfs_%d:%.2f afps:%.2f\n",
+                "EGL", v[0], "bench", i, v[1], v[2], v[3], v[4], 64, v[5], v[6]);
+    }
+    fflush(file);
+    return getSeconds() - start;
+}
+
+static double benchFormat(FILE* file, int lines)
+{
+    double start = getSeconds();
+    float v[7];
+    int i;
+
+    formatInit(file);
+    for (i = 0; i < lines; i++)
+    {
+        makeValues(i, v);
+        formatPadded("EGL", 4);
+        formatString(" -- ");
+        formatFixed(v[0], FORMAT_ROUNDED_DECIMALS);
+        formatString(" -- ");
+        formatString("bench");
+        formatString(" -- frame:");
+        formatInt(i);
+        formatString(" dur:");
+        formatFixed(v[1], FORMAT_ROUNDED_DECIMALS);
+        formatString(" ifps:");
+        formatFixed(v[2], FORMAT_ROUNDED_DECIMALS);
+        formatString(" min:");
+        formatFixed(v[3], FORMAT_ROUNDED_DECIMALS);
+        formatString(" max:");
+        formatFixed(v[4], FORMAT_ROUNDED_DECIMALS);
+        formatString(" apfs_");
+        formatInt(64);
+        formatString(":");
+        formatFixed(v[5], FORMAT_ROUNDED_DECIMALS);
+        formatString(" afps:");
+        formatFixed(v[6], FORMAT_ROUNDED_DECIMALS);
+        formatEndLine();
+    }
+    formatFlush();
+    return getSeconds() - start;
+}
+
+static int compareFiles(FILE* a, FILE* b)
+{
+    char lineA[256], lineB[256];
+    int line = 0;
+
+    rewind(a);
+    rewind(b);
+    while (fgets(lineA, sizeof(lineA), a))
+    {
+        line++;
+        if (!fgets(lineB, sizeof(lineB), b) || strcmp(lineA, lineB))
+        {
+            fprintf(stderr, "Output differs at line %d\n", line);
+            return 0;
+        }
+    }
+    return !fgets(lineB, sizeof(lineB), b);
+}
+
+int main(int argc, char** argv)
+{
+    int lines = argc > 1 ? atoi(argv[1]) : DEFAULT_LINES;
+    FILE* printfFile = tmpfile();
+    FILE* formatFile = tmpfile();
+    double printfTime, formatTime;
+
+    if (lines <= 0 || !printfFile || !formatFile)
+    {
+        fprintf(stderr, "Usage: %s [lines]\n", argv[0]);
+        return 1;
+    }
+
+    printfTime = benchPrintf(printfFile, lines);
+    formatTime = benchFormat(formatFile, lines);
+
+    printf("fprintf:   %.1f ns/line\n", printfTime / lines * 1e9);
+    printf("formatter: %.1f ns/line\n", formatTime / lines * 1e9);
+    printf("speedup:   %.2fx\n", printfTime / formatTime);
+
+    if (!compareFiles(printfFile, formatFile))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,334 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger.h"
+#include "swaplogger_gate.h"
+#include "swaplogger_histogram.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_CONDITIONS      8
+#define MAX_WINDOWS         256
+#define MAX_METRIC_NAME     16
+
+int gate_warmupFrames = 0;
+
+enum Metric
+{
+    METRIC_AVERAGE_FPS,
+    METRIC_MIN_FPS,
+    METRIC_MAX_FPS,
+    METRIC_PERCENTILE,
+    METRIC_MAX_DURATION,
+};
+
+static struct Condition
+{
+    char name[MAX_METRIC_NAME];
+    enum Metric metric;
+    float percent;
+    char op;
+    float limit;
+} conditions[MAX_CONDITIONS];
+
+static int conditionCount = 0;
+
+/** Results of the evaluated windows, kept for rewriting the verdict file */
+static struct Window
+{
+    float time;
+    int frames;
+    int failed;
+    float values[MAX_CONDITIONS];
+} windows[MAX_WINDOWS];
+
+static int windowCount = 0;
+static int droppedWindows = 0;
+
+/** Counted apart from the table, which only keeps the latest dropped window */
+static int measuredWindows = 0;
+static int failedWindows = 0;
+
+static const char* verdictPath;
+static struct Histogram histogram;
+static int warmupLeft;
+static int framesSeen = 0;
+
+/** Parse e.g. "afps<55" or "p99>20ms"; the unit must suit the metric */
+static int parseCondition(const char* text, struct Condition* c)
+{
+    size_t len = strcspn(text, "<>");
+    const char* unit;
+    char* end;
+
+    if (!len || len >= MAX_METRIC_NAME || !text[len])
+    {
+        return 0;
+    }
+    memcpy(c->name, text, len);
+    c->name[len] = 0;
+    c->op = text[len];
+    c->limit = strtof(text + len + 1, &end);
+    if (end == text + len + 1)
+    {
+        return 0;
+    }
+
+    if (!strcmp(c->name, "afps"))
+    {
+        c->metric = METRIC_AVERAGE_FPS;
+    }
+    else if (!strcmp(c->name, "min"))
+    {
+        c->metric = METRIC_MIN_FPS;
+    }
+    else if (!strcmp(c->name, "max"))
+    {
+        c->metric = METRIC_MAX_FPS;
+    }
+    else if (!strcmp(c->name, "dur_max"))
+    {
+        c->metric = METRIC_MAX_DURATION;
+    }
+    else if (c->name[0] == 'p' && atof(c->name + 1) > 0 && atof(c->name + 1) <= 100)
+    {
+        c->metric = METRIC_PERCENTILE;
+        c->percent = atof(c->name + 1);
+    }
+    else
+    {
+        return 0;
+    }
+
+    unit = c->metric == METRIC_PERCENTILE || c->metric == METRIC_MAX_DURATION ?
+           "ms" : "fps";
+    return !*end || !strcmp(end, unit);
+}
+
+static void writeString(FILE* file, const char* s);
+
+/**
+ *  Leave a verdict with an error message, so that a configuration error
+ *  can be told apart from a failed run.
+ */
+static void writeError(const char* error)
+{
+    FILE* file = fopen(verdictPath, "w");
+
+    printInfo("%s", error);
+    if (!file)
+    {
+        perror("fopen");
+        return;
+    }
+    fprintf(file, "{\n  \"pass\": false,\n  \"error\": ");
+    writeString(file, error);
+    fprintf(file, "\n}\n");
+    fclose(file);
+}
+
+int gateInit(const char* spec, const char* path)
+{
+    char text[256];
+    char error[320];
+    char* condition;
+    char* saveptr;
+
+    strncpy(text, spec, sizeof(text) - 1);
+    text[sizeof(text) - 1] = 0;
+    verdictPath = path;
+
+    for (condition = strtok_r(text, ",", &saveptr); condition;
+         condition = strtok_r(NULL, ",", &saveptr))
+    {
+        if (conditionCount >= MAX_CONDITIONS)
+        {
+            writeError("Too many gate conditions");
+            conditionCount = 0;
+            return 0;
+        }
+        if (!parseCondition(condition, &conditions[conditionCount]))
+        {
+            snprintf(error, sizeof(error), "Invalid gate condition: %s", condition);
+            writeError(error);
+            conditionCount = 0;
+            return 0;
+        }
+        conditionCount++;
+    }
+    if (!conditionCount)
+    {
+        writeError("No gate conditions");
+        return 0;
+    }
+
+    histogramReset(&histogram);
+    warmupLeft = gate_warmupFrames;
+    return 1;
+}
+
+void gateAddFrame(int64_t duration)
+{
+    framesSeen++;
+    if (warmupLeft > 0)
+    {
+        warmupLeft--;
+        return;
+    }
+    if (duration > 0)
+    {
+        histogramAdd(&histogram, duration);
+    }
+}
+
+static float measure(const struct Condition* c)
+{
+    switch (c->metric)
+    {
+    case METRIC_AVERAGE_FPS:
+        return histogramAverageFps(&histogram);
+    case METRIC_MIN_FPS:
+        return framesPerSecond(histogram.maxDuration);
+    case METRIC_MAX_FPS:
+        return framesPerSecond(histogram.minDuration);
+    case METRIC_PERCENTILE:
+        return milliseconds(histogramPercentile(&histogram, c->percent));
+    case METRIC_MAX_DURATION:
+        return milliseconds(histogram.maxDuration);
+    }
+    return 0.0f;
+}
+
+static int fails(const struct Condition* c, float value)
+{
+    return c->op == '>' ? value > c->limit : value < c->limit;
+}
+
+static void writeString(FILE* file, const char* s)
+{
+    fputc('"', file);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fputc('\\', file);
+        }
+        if ((unsigned char)*s >= 0x20)
+        {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/**
+ *  The run passes when no window failed and at least one window had
+ *  frames to evaluate.
+ */
+static void writeVerdict(const char* processName)
+{
+    FILE* file;
+    int i, j;
+
+    file = fopen(verdictPath, "w");
+    if (!file)
+    {
+        perror("fopen");
+        return;
+    }
+
+    fprintf(file, "{\n  \"process\": ");
+    writeString(file, processName);
+    fprintf(file, ",\n  \"pass\": %s,\n  \"warmup_frames\": %d,\n",
+            measuredWindows && !failedWindows ? "true" : "false", gate_warmupFrames);
+    fprintf(file, "  \"failed_windows\": %d,\n  \"dropped_windows\": %d,\n"
+            "  \"windows\": [", failedWindows, droppedWindows);
+
+    for (i = 0; i < windowCount; i++)
+    {
+        const struct Window* w = &windows[i];
+
+        fprintf(file, "%s\n    {\n      \"time\": %.2f,\n      \"frames\": %d,\n"
+                "      \"pass\": %s,\n      \"conditions\": [",
+                i ? "," : "", w->time, w->frames, w->failed ? "false" : "true");
+        for (j = 0; j < conditionCount && w->frames; j++)
+        {
+            const struct Condition* c = &conditions[j];
+
+            fprintf(file, "%s\n        { \"metric\": \"%s\", \"op\": \"%c\", "
+                    "\"limit\": %.2f, \"value\": %.2f, \"pass\": %s }",
+                    j ? "," : "", c->name, c->op, c->limit, w->values[j],
+                    fails(c, w->values[j]) ? "false" : "true");
+        }
+        fprintf(file, "%s]\n    }", j ? "\n      " : "");
+    }
+    fprintf(file, "%s]\n}\n", windowCount ? "\n  " : "");
+    fclose(file);
+}
+
+void gateEvaluate(FILE* output, const char* processName, float time)
+{
+    struct Window* w;
+    int i;
+
+    if (!conditionCount)
+    {
+        return;
+    }
+
+    /* Keep the first windows and the latest one once the table is full */
+    if (windowCount == MAX_WINDOWS)
+    {
+        windowCount--;
+        droppedWindows++;
+    }
+    w = &windows[windowCount++];
+    w->time = time;
+    w->frames = histogram.frames;
+    w->failed = 0;
+
+    fprintf(output, "GATE -- %.2f -- %s -- frames:%d", time, processName, w->frames);
+    for (i = 0; i < conditionCount && w->frames; i++)
+    {
+        const struct Condition* c = &conditions[i];
+
+        w->values[i] = measure(c);
+        w->failed |= fails(c, w->values[i]);
+        fprintf(output, " %s:%.2f%c%g:%s", c->name, w->values[i], c->op, c->limit,
+                fails(c, w->values[i]) ? "fail" : "ok");
+    }
+    fprintf(output, " %s\n", w->failed ? "FAIL" : "PASS");
+    measuredWindows += w->frames > 0;
+    failedWindows += w->failed;
+
+    /* Processes that never rendered, e.g. helpers started by the program,
+     * must not replace the verdict of the one that did */
+    if (framesSeen)
+    {
+        writeVerdict(processName);
+    }
+
+    histogramReset(&histogram);
+    warmupLeft = gate_warmupFrames;
+}
@@ -0,0 +1,53 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_GATE_H
+#define SWAPLOGGER_GATE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ *  Frame time budget gate
+ *
+ *  Conditions are given as a comma separated list of failure conditions,
+ *  for example "p99>20ms,afps<55". Supported metrics are afps, min and max
+ *  (FPS), pNN (NNth percentile frame duration in milliseconds) and dur_max
+ *  (longest frame in milliseconds). A limit may be followed by the unit of
+ *  its metric, "ms" or "fps". Frames are collected in windows that
+ *  end at each reset and at exit, skipping gate_warmupFrames frames at the
+ *  start of each window. After every window the verdict of the whole run so
+ *  far is written to the verdict file as JSON, unless no frames have been
+ *  seen at all. Invalid conditions are reported with an "error" field in
+ *  the verdict file instead.
+ */
+int gateInit(const char* conditions, const char* path);
+
+/** Called for every counted frame with swapLock held */
+void gateAddFrame(int64_t duration);
+
+/** Evaluate and close the current window; called with swapLock held */
+void gateEvaluate(FILE* output, const char* processName, float time);
+
+extern int gate_warmupFrames;
+
+#endif /* SWAPLOGGER_GATE_H */
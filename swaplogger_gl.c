@@ -0,0 +1,444 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+/* RTLD_NEXT */
+#define _GNU_SOURCE
+
+#include "swaplogger.h"
+#include "swaplogger_gl.h"
+
+#include <GLES2/gl2.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+/**
+ *  Profiled entry points. Each entry gives the function name, its
+ *  parameters and the arguments to pass on. Upload entries also give the
+ *  number of bytes the call uploads. All profiled functions return void.
+ */
+#define GL_DRAW_FUNCTIONS(F) \
+    F(glDrawArrays, (GLenum mode, GLint first, GLsizei count), \
+      (mode, first, count)) \
+    F(glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices), \
+      (mode, count, type, indices))
+
+#define GL_STATE_FUNCTIONS(F) \
+    F(glEnable, (GLenum cap), (cap)) \
+    F(glDisable, (GLenum cap), (cap)) \
+    F(glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor)) \
+    F(glBlendFuncSeparate, (GLenum sfactorRGB, GLenum dfactorRGB, \
+                            GLenum sfactorAlpha, GLenum dfactorAlpha), \
+      (sfactorRGB, dfactorRGB, sfactorAlpha, dfactorAlpha)) \
+    F(glUseProgram, (GLuint program), (program)) \
+    F(glActiveTexture, (GLenum texture), (texture)) \
+    F(glBindTexture, (GLenum target, GLuint texture), (target, texture)) \
+    F(glBindBuffer, (GLenum target, GLuint buffer), (target, buffer)) \
+    F(glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer)) \
+    F(glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), \
+      (x, y, width, height)) \
+    F(glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), \
+      (x, y, width, height)) \
+    F(glDepthFunc, (GLenum func), (func)) \
+    F(glDepthMask, (GLboolean flag), (flag)) \
+    F(glColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha), \
+      (red, green, blue, alpha)) \
+    F(glCullFace, (GLenum mode), (mode)) \
+    F(glTexParameteri, (GLenum target, GLenum pname, GLint param), \
+      (target, pname, param)) \
+    F(glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, \
+                              GLsizei stride, const void* pointer), \
+      (index, size, type, normalized, stride, pointer)) \
+    F(glUniform1i, (GLint location, GLint v0), (location, v0)) \
+    F(glUniform1f, (GLint location, GLfloat v0), (location, v0)) \
+    F(glUniform4fv, (GLint location, GLsizei count, const GLfloat* value), \
+      (location, count, value)) \
+    F(glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, \
+                           const GLfloat* value), \
+      (location, count, transpose, value))
+
+#define GL_UPLOAD_FUNCTIONS(F) \
+    F(glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, \
+                     GLsizei height, GLint border, GLenum format, GLenum type, \
+                     const void* pixels), \
+      (target, level, internalformat, width, height, border, format, type, pixels), \
+      pixels ? textureBytes(width, height, format, type) : 0) \
+    F(glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, \
+                        GLsizei width, GLsizei height, GLenum format, GLenum type, \
+                        const void* pixels), \
+      (target, level, xoffset, yoffset, width, height, format, type, pixels), \
+      pixels ? textureBytes(width, height, format, type) : 0) \
+    F(glCompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, \
+                               GLsizei width, GLsizei height, GLint border, \
+                               GLsizei imageSize, const void* data), \
+      (target, level, internalformat, width, height, border, imageSize, data), \
+      data ? imageSize : 0) \
+    F(glCompressedTexSubImage2D, (GLenum target, GLint level, GLint xoffset, \
+                                  GLint yoffset, GLsizei width, GLsizei height, \
+                                  GLenum format, GLsizei imageSize, const void* data), \
+      (target, level, xoffset, yoffset, width, height, format, imageSize, data), \
+      data ? imageSize : 0) \
+    F(glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), \
+      (target, size, data, usage), \
+      data ? size : 0) \
+    F(glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), \
+      (target, offset, size, data), \
+      size)
+
+#define GL_STALL_FUNCTIONS(F) \
+    F(glCompileShader, (GLuint shader), (shader)) \
+    F(glLinkProgram, (GLuint program), (program)) \
+    F(glFinish, (void), ())
+
+int profile_GLCalls = 0;
+
+/**
+ *  Call counters of one thread. Only the owning thread writes them, and
+ *  the counts only ever grow, so the swapping thread can read them without
+ *  locking. seen holds the counts already taken into a frame and is only
+ *  used with swapLock held. When a thread exits its block is handed to the
+ *  next new thread instead of being freed, since the swapping thread may
+ *  be reading it.
+ */
+struct Counts
+{
+    uint64_t drawCalls;
+    uint64_t stateChanges;
+    uint64_t uploadBytes;
+    uint64_t stallTime;
+};
+
+struct Counters
+{
+    struct Counts counts;
+    struct Counts seen;
+    int inUse;
+    struct Counters* next;
+};
+
+static __thread struct Counters* threadCounters;
+static struct Counters* allCounters;
+static pthread_key_t countersKey;
+
+/** Totals since start or reset */
+static struct
+{
+    int frames;
+    int64_t drawCalls;
+    int64_t stateChanges;
+    int64_t uploadBytes;
+    int64_t stallTime;
+} totals;
+
+/** Size of a client side image, ignoring the unpack alignment */
+static int64_t textureBytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+    int bytesPerPixel;
+
+    switch (type)
+    {
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        bytesPerPixel = 2;
+        break;
+    default:
+        switch (format)
+        {
+        case GL_ALPHA:
+        case GL_LUMINANCE:
+            bytesPerPixel = 1;
+            break;
+        case GL_LUMINANCE_ALPHA:
+            bytesPerPixel = 2;
+            break;
+        case GL_RGB:
+            bytesPerPixel = 3;
+            break;
+        default:
+            bytesPerPixel = 4;
+            break;
+        }
+        break;
+    }
+    return (int64_t)width * height * bytesPerPixel;
+}
+
+/** Called when a thread that made GL calls exits */
+static void releaseCounters(void* counters)
+{
+    struct Counters* c = counters;
+
+    threadCounters = NULL;
+    __atomic_store_n(&c->inUse, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ *  Take the block of an exited thread or add a new one. A reused block
+ *  keeps its counts, so calls not yet taken into a frame aren't lost.
+ */
+static struct Counters* addCounters(void)
+{
+    struct Counters* c;
+
+    for (c = __atomic_load_n(&allCounters, __ATOMIC_ACQUIRE); c; c = c->next)
+    {
+        if (!__atomic_exchange_n(&c->inUse, 1, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+    }
+    if (!c)
+    {
+        c = calloc(1, sizeof(*c));
+        if (!c)
+        {
+            return NULL;
+        }
+        c->inUse = 1;
+        c->next = __atomic_load_n(&allCounters, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&allCounters, &c->next, c, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+        }
+    }
+    pthread_setspecific(countersKey, c);
+    threadCounters = c;
+    return c;
+}
+
+/** Add to a counter of the calling thread, if profiling */
+#define COUNT(field, value) \
+    if (profile_GLCalls) \
+    { \
+        struct Counters* c = threadCounters ? threadCounters : addCounters(); \
+        if (c) \
+        { \
+            __atomic_store_n(&c->counts.field, c->counts.field + (value), \
+                             __ATOMIC_RELAXED); \
+        } \
+    }
+
+#define DECLARE_REAL(name, params, args, ...) \
+    static void (GL_APIENTRY *real_##name) params;
+
+/* Used if a function can't be found at all, e.g. in a GLES 1.1 program */
+#define DEFINE_NOOP(name, params, args, ...) \
+    static void GL_APIENTRY noop_##name params \
+    { \
+    }
+
+static GLProfileFunction resolve(const char* name, GLProfileFunction noop);
+
+GL_DRAW_FUNCTIONS(DECLARE_REAL)
+GL_STATE_FUNCTIONS(DECLARE_REAL)
+GL_UPLOAD_FUNCTIONS(DECLARE_REAL)
+GL_STALL_FUNCTIONS(DECLARE_REAL)
+
+GL_DRAW_FUNCTIONS(DEFINE_NOOP)
+GL_STATE_FUNCTIONS(DEFINE_NOOP)
+GL_UPLOAD_FUNCTIONS(DEFINE_NOOP)
+GL_STALL_FUNCTIONS(DEFINE_NOOP)
+
+/* Resolving lazily only adds a predictable branch to the indirect call */
+#define CALL_REAL(name, params, args) \
+    if (!real_##name) \
+    { \
+        real_##name = (void (GL_APIENTRY *) params) \
+            resolve(#name, (GLProfileFunction)noop_##name); \
+    } \
+    real_##name args;
+
+#define DEFINE_DRAW(name, params, args) \
+    SWAPLOGGER_EXPORT GL_APICALL void GL_APIENTRY name params \
+    { \
+        COUNT(drawCalls, 1) \
+        CALL_REAL(name, params, args) \
+    }
+
+#define DEFINE_STATE(name, params, args) \
+    SWAPLOGGER_EXPORT GL_APICALL void GL_APIENTRY name params \
+    { \
+        COUNT(stateChanges, 1) \
+        CALL_REAL(name, params, args) \
+    }
+
+#define DEFINE_UPLOAD(name, params, args, bytes) \
+    SWAPLOGGER_EXPORT GL_APICALL void GL_APIENTRY name params \
+    { \
+        COUNT(uploadBytes, (bytes)) \
+        CALL_REAL(name, params, args) \
+    }
+
+/* Timing costs two clock reads, so it is skipped unless profiling */
+#define DEFINE_STALL(name, params, args) \
+    SWAPLOGGER_EXPORT GL_APICALL void GL_APIENTRY name params \
+    { \
+        int64_t start = profile_GLCalls ? getMonotonicTime() : 0; \
+        CALL_REAL(name, params, args) \
+        if (start) \
+        { \
+            COUNT(stallTime, getMonotonicTime() - start) \
+        } \
+    }
+
+GL_DRAW_FUNCTIONS(DEFINE_DRAW)
+GL_STATE_FUNCTIONS(DEFINE_STATE)
+GL_UPLOAD_FUNCTIONS(DEFINE_UPLOAD)
+GL_STALL_FUNCTIONS(DEFINE_STALL)
+
+#define TABLE_ENTRY(name, params, args, ...) \
+    { #name, (GLProfileFunction)name, (GLProfileFunction*)&real_##name },
+
+static const struct
+{
+    const char* name;
+    GLProfileFunction wrapper;
+    GLProfileFunction* real;
+} functions[] =
+{
+    GL_DRAW_FUNCTIONS(TABLE_ENTRY)
+    GL_STATE_FUNCTIONS(TABLE_ENTRY)
+    GL_UPLOAD_FUNCTIONS(TABLE_ENTRY)
+    GL_STALL_FUNCTIONS(TABLE_ENTRY)
+};
+
+#define FUNCTION_COUNT  (sizeof(functions) / sizeof(functions[0]))
+
+/**
+ *  Look up the function the application would have called without the
+ *  swap logger. This is done lazily as well, since the GL library may be
+ *  loaded with dlopen after initialization. A library loaded with
+ *  RTLD_LOCAL isn't visible to RTLD_NEXT, so fall back to opening
+ *  libGLESv2 directly, and to a function that does nothing if the
+ *  function doesn't exist at all.
+ */
+static GLProfileFunction resolve(const char* name, GLProfileFunction noop)
+{
+    static void* library = NULL;
+    GLProfileFunction f = (GLProfileFunction)dlsym(RTLD_NEXT, name);
+
+    if (!f)
+    {
+        if (!library)
+        {
+            library = dlopen("libGLESv2.so.2", RTLD_NOW | RTLD_LOCAL);
+        }
+        if (library)
+        {
+            f = (GLProfileFunction)dlsym(library, name);
+        }
+    }
+    if (!f)
+    {
+        printInfo("Unable to look up %s", name);
+        f = noop;
+    }
+    return f;
+}
+
+void glProfileInit(void)
+{
+    int i;
+
+    pthread_key_create(&countersKey, releaseCounters);
+
+    for (i = 0; i < FUNCTION_COUNT; i++)
+    {
+        *functions[i].real = (GLProfileFunction)dlsym(RTLD_NEXT, functions[i].name);
+    }
+}
+
+GLProfileFunction glProfileGetProcAddress(const char* procName, GLProfileFunction f)
+{
+    int i;
+
+    if (!profile_GLCalls || !procName || !f)
+    {
+        return f;
+    }
+
+    for (i = 0; i < FUNCTION_COUNT; i++)
+    {
+        if (!strcmp(procName, functions[i].name))
+        {
+            if (!*functions[i].real)
+            {
+                *functions[i].real = f;
+            }
+            return functions[i].wrapper;
+        }
+    }
+    return f;
+}
+
+void glProfileFrame(struct GLProfileFrame* frame)
+{
+    struct Counters* c;
+
+    memset(frame, 0, sizeof(*frame));
+    for (c = __atomic_load_n(&allCounters, __ATOMIC_ACQUIRE); c; c = c->next)
+    {
+        uint64_t drawCalls = __atomic_load_n(&c->counts.drawCalls, __ATOMIC_RELAXED);
+        uint64_t stateChanges = __atomic_load_n(&c->counts.stateChanges, __ATOMIC_RELAXED);
+        uint64_t uploadBytes = __atomic_load_n(&c->counts.uploadBytes, __ATOMIC_RELAXED);
+        uint64_t stallTime = __atomic_load_n(&c->counts.stallTime, __ATOMIC_RELAXED);
+
+        frame->drawCalls += drawCalls - c->seen.drawCalls;
+        frame->stateChanges += stateChanges - c->seen.stateChanges;
+        frame->uploadBytes += uploadBytes - c->seen.uploadBytes;
+        frame->stallTime += stallTime - c->seen.stallTime;
+        c->seen.drawCalls = drawCalls;
+        c->seen.stateChanges = stateChanges;
+        c->seen.uploadBytes = uploadBytes;
+        c->seen.stallTime = stallTime;
+    }
+
+    totals.frames++;
+    totals.drawCalls += frame->drawCalls;
+    totals.stateChanges += frame->stateChanges;
+    totals.uploadBytes += frame->uploadBytes;
+    totals.stallTime += frame->stallTime;
+}
+
+void glProfilePrint(FILE* output, const char* processName, float time)
+{
+    int frames = totals.frames ? totals.frames : 1;
+
+    fprintf(output, "GLPR -- %.2f -- %s -- frames:%d draws:%lld state:%lld "
+            "upload_bytes:%lld stall:%.2f draws_per_frame:%.2f state_per_frame:%.2f "
+            "upload_bytes_per_frame:%.0f stall_per_frame:%.2f\n",
+            time, processName, totals.frames, (long long)totals.drawCalls,
+            (long long)totals.stateChanges, (long long)totals.uploadBytes,
+            milliseconds(totals.stallTime),
+            (float)totals.drawCalls / frames, (float)totals.stateChanges / frames,
+            (float)totals.uploadBytes / frames, milliseconds(totals.stallTime) / frames);
+}
+
+void glProfileReset(void)
+{
+    memset(&totals, 0, sizeof(totals));
+}
@@ -0,0 +1,73 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_GL_H
+#define SWAPLOGGER_GL_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ *  GL API call profiler
+ *
+ *  The GL entry points listed in swaplogger_gl.c are interposed both as
+ *  exported symbols and, if profile_GLCalls is set, through
+ *  eglGetProcAddress. Each wrapper makes a single call to the real
+ *  function and, if profile_GLCalls is set, updates a counter of the
+ *  calling thread. The counters of all threads are collected per frame
+ *  with glProfileFrame(). The wrappers are generated from tables of entry
+ *  points, so adding one takes a single line.
+ */
+struct GLProfileFrame
+{
+    /** Number of draw calls */
+    int drawCalls;
+
+    /** Number of state changing calls */
+    int stateChanges;
+
+    /** Bytes uploaded to textures and buffers */
+    int64_t uploadBytes;
+
+    /** Time spent in calls that wait for the GL, such as glFinish */
+    int64_t stallTime;
+};
+
+typedef void (*GLProfileFunction)(void);
+
+void glProfileInit(void);
+
+/**
+ *  Return the wrapper for a function looked up with eglGetProcAddress, or
+ *  the function itself if it isn't profiled.
+ */
+GLProfileFunction glProfileGetProcAddress(const char* procName, GLProfileFunction f);
+
+/** Take and clear the counters of the current frame; called with swapLock held */
+void glProfileFrame(struct GLProfileFrame* frame);
+
+void glProfilePrint(FILE* output, const char* processName, float time);
+void glProfileReset(void);
+
+extern int profile_GLCalls;
+
+#endif /* SWAPLOGGER_GL_H */
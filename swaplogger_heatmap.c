@@ -0,0 +1,412 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger.h"
+#include "swaplogger_heatmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define MAX_SURFACES        16
+#define MAX_GRID_SIZE       2048
+#define MAX_TOP_REGIONS     64
+
+/* Cells repainted at least this percentage as often as the hottest one */
+#define REGION_THRESHOLD    10
+
+int heatmap_scale = 8;
+int heatmap_topRegions = 10;
+const char* heatmap_directory = ".";
+
+/** Four grid cells, updated with a single vector add */
+typedef uint32_t CellVector __attribute__((vector_size(16)));
+
+#define CELLS_PER_VECTOR    (sizeof(CellVector) / sizeof(uint32_t))
+
+struct Surface
+{
+    const char* source;
+    uintptr_t handle;
+    uint64_t lastUsed;
+    int width, height;
+    int stride;
+    uint32_t* cells;
+};
+
+static struct Surface surfaces[MAX_SURFACES];
+static int surfaceCount = 0;
+static int dumpSerial = 0;
+static uint64_t addSerial = 0;
+static int evictedSurfaces = 0;
+
+/**
+ *  Find the grid of a surface. When the table is full, the least recently
+ *  used grid is dropped to make room, e.g. for a window that was closed.
+ */
+static struct Surface* findSurface(const char* source, uintptr_t handle)
+{
+    struct Surface* s;
+    int i;
+
+    for (i = 0; i < surfaceCount; i++)
+    {
+        if (surfaces[i].handle == handle && !strcmp(surfaces[i].source, source))
+        {
+            return &surfaces[i];
+        }
+    }
+
+    if (surfaceCount < MAX_SURFACES)
+    {
+        s = &surfaces[surfaceCount++];
+    }
+    else
+    {
+        s = &surfaces[0];
+        for (i = 1; i < surfaceCount; i++)
+        {
+            if (surfaces[i].lastUsed < s->lastUsed)
+            {
+                s = &surfaces[i];
+            }
+        }
+        free(s->cells);
+        memset(s, 0, sizeof(*s));
+        evictedSurfaces++;
+    }
+    s->source = source;
+    s->handle = handle;
+    return s;
+}
+
+/**
+ *  Grow the grid to at least width x height cells. Rows are padded to a
+ *  multiple of the vector size and kept aligned for the vector updates.
+ */
+static int growSurface(struct Surface* s, int width, int height)
+{
+    uint32_t* cells;
+    int stride;
+    int y;
+
+    if (width <= s->width && height <= s->height)
+    {
+        return 1;
+    }
+
+    width = width > s->width ? width + width / 2 : s->width;
+    height = height > s->height ? height + height / 2 : s->height;
+    width = width < MAX_GRID_SIZE ? width : MAX_GRID_SIZE;
+    height = height < MAX_GRID_SIZE ? height : MAX_GRID_SIZE;
+    stride = (width + CELLS_PER_VECTOR - 1) & ~(CELLS_PER_VECTOR - 1);
+
+    if (posix_memalign((void**)&cells, sizeof(CellVector),
+                       (size_t)stride * height * sizeof(uint32_t)))
+    {
+        return 0;
+    }
+    memset(cells, 0, (size_t)stride * height * sizeof(uint32_t));
+
+    for (y = 0; y < s->height; y++)
+    {
+        memcpy(&cells[y * stride], &s->cells[y * s->stride],
+               s->width * sizeof(uint32_t));
+    }
+    free(s->cells);
+
+    s->cells = cells;
+    s->width = width;
+    s->height = height;
+    s->stride = stride;
+    return 1;
+}
+
+/** Increment cells [x0, x1) of one row */
+static void addSpan(uint32_t* row, int x0, int x1)
+{
+    const CellVector one = { 1, 1, 1, 1 };
+    int x = x0;
+
+    for (; x < x1 && (x % CELLS_PER_VECTOR); x++)
+    {
+        row[x]++;
+    }
+    for (; x + (int)CELLS_PER_VECTOR <= x1; x += CELLS_PER_VECTOR)
+    {
+        *(CellVector*)&row[x] += one;
+    }
+    for (; x < x1; x++)
+    {
+        row[x]++;
+    }
+}
+
+void heatmapAdd(const char* source, uintptr_t surface, int numRects,
+                const struct Rect* rects)
+{
+    struct Surface* s = findSurface(source, surface);
+    int i;
+
+    s->lastUsed = ++addSerial;
+
+    for (i = 0; i < numRects; i++)
+    {
+        int x0 = rects[i].x > 0 ? rects[i].x / heatmap_scale : 0;
+        int y0 = rects[i].y > 0 ? rects[i].y / heatmap_scale : 0;
+        int x1 = (rects[i].x + rects[i].w + heatmap_scale - 1) / heatmap_scale;
+        int y1 = (rects[i].y + rects[i].h + heatmap_scale - 1) / heatmap_scale;
+        int y;
+
+        if (x1 <= x0 || y1 <= y0)
+        {
+            continue;
+        }
+        if (!growSurface(s, x1, y1))
+        {
+            return;
+        }
+        x1 = x1 < s->width ? x1 : s->width;
+        y1 = y1 < s->height ? y1 : s->height;
+
+        for (y = y0; y < y1; y++)
+        {
+            addSpan(&s->cells[y * s->stride], x0, x1);
+        }
+    }
+}
+
+static void writeImage(const struct Surface* s, uint32_t maxCount)
+{
+    char path[512];
+    unsigned char* row;
+    FILE* file;
+    int x, y;
+
+    snprintf(path, sizeof(path), "%s/swaplogger.%d.%s-%lx.%d.pgm",
+             heatmap_directory, (int)getpid(), s->source,
+             (unsigned long)s->handle, dumpSerial);
+
+    file = fopen(path, "wb");
+    if (!file)
+    {
+        perror("fopen");
+        return;
+    }
+
+    row = malloc(s->width);
+    fprintf(file, "P5\n%d %d\n255\n", s->width, s->height);
+    for (y = 0; y < s->height && row; y++)
+    {
+        for (x = 0; x < s->width; x++)
+        {
+            row[x] = (uint64_t)s->cells[y * s->stride + x] * 255 / maxCount;
+        }
+        fwrite(row, 1, s->width, file);
+    }
+    free(row);
+    fclose(file);
+}
+
+/** Connected hot cells, in cells, and how often they were repainted */
+struct Region
+{
+    int x0, y0, x1, y1;
+    uint32_t peak;
+    uint64_t total;
+};
+
+/** Push a cell, indexed as y * width + x, if it is hot and not yet seen */
+static void visitCell(const struct Surface* s, unsigned char* seen, int* stack,
+                      int* depth, int cell, uint32_t threshold)
+{
+    int x = cell % s->width;
+    int y = cell / s->width;
+
+    if (!seen[cell] && s->cells[y * s->stride + x] >= threshold)
+    {
+        seen[cell] = 1;
+        stack[(*depth)++] = cell;
+    }
+}
+
+/** Flood fill the hot cells connected to start into one region */
+static void fillRegion(const struct Surface* s, unsigned char* seen, int* stack,
+                       int start, uint32_t threshold, struct Region* r)
+{
+    int depth = 0;
+
+    r->x0 = r->x1 = start % s->width;
+    r->y0 = r->y1 = start / s->width;
+    r->peak = 0;
+    r->total = 0;
+
+    visitCell(s, seen, stack, &depth, start, threshold);
+    while (depth)
+    {
+        int cell = stack[--depth];
+        int x = cell % s->width;
+        int y = cell / s->width;
+        uint32_t value = s->cells[y * s->stride + x];
+
+        r->x0 = x < r->x0 ? x : r->x0;
+        r->y0 = y < r->y0 ? y : r->y0;
+        r->x1 = x + 1 > r->x1 ? x + 1 : r->x1;
+        r->y1 = y + 1 > r->y1 ? y + 1 : r->y1;
+        r->peak = value > r->peak ? value : r->peak;
+        r->total += value;
+
+        if (x > 0)
+        {
+            visitCell(s, seen, stack, &depth, cell - 1, threshold);
+        }
+        if (x < s->width - 1)
+        {
+            visitCell(s, seen, stack, &depth, cell + 1, threshold);
+        }
+        if (y > 0)
+        {
+            visitCell(s, seen, stack, &depth, cell - s->width, threshold);
+        }
+        if (y < s->height - 1)
+        {
+            visitCell(s, seen, stack, &depth, cell + s->width, threshold);
+        }
+    }
+}
+
+/**
+ *  Print the hottest regions of a surface. Neighbouring cells that are hot
+ *  enough are merged into bounding rectangles, which are ranked by their
+ *  total repaint count, so that an area repainted as a whole is reported
+ *  once instead of as many equally hot cells.
+ */
+static void printTopRegions(FILE* output, const struct Surface* s,
+                            const char* processName, float time,
+                            uint32_t maxCount)
+{
+    struct Region top[MAX_TOP_REGIONS];
+    struct Region region;
+    uint32_t threshold = (uint64_t)maxCount * REGION_THRESHOLD / 100;
+    int n = heatmap_topRegions < MAX_TOP_REGIONS ? heatmap_topRegions : MAX_TOP_REGIONS;
+    int count = 0;
+    unsigned char* seen;
+    int* stack;
+    int cell, i;
+
+    if (n <= 0)
+    {
+        return;
+    }
+    seen = calloc((size_t)s->width * s->height, 1);
+    stack = malloc((size_t)s->width * s->height * sizeof(int));
+    if (!seen || !stack)
+    {
+        free(seen);
+        free(stack);
+        return;
+    }
+    threshold = threshold ? threshold : 1;
+
+    for (cell = 0; cell < s->width * s->height; cell++)
+    {
+        if (seen[cell] ||
+            s->cells[(cell / s->width) * s->stride + cell % s->width] < threshold)
+        {
+            continue;
+        }
+        fillRegion(s, seen, stack, cell, threshold, &region);
+
+        /* Insertion sort of the hottest regions */
+        if (count == n && region.total <= top[count - 1].total)
+        {
+            continue;
+        }
+        i = count < n ? count++ : count - 1;
+        while (i > 0 && top[i - 1].total < region.total)
+        {
+            top[i] = top[i - 1];
+            i--;
+        }
+        top[i] = region;
+    }
+    free(seen);
+    free(stack);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(output, "HEAT -- %.2f -- %s -- source:%s surface:0x%lx "
+                "x:%d y:%d w:%d h:%d count:%u\n",
+                time, processName, s->source, (unsigned long)s->handle,
+                top[i].x0 * heatmap_scale, top[i].y0 * heatmap_scale,
+                (top[i].x1 - top[i].x0) * heatmap_scale,
+                (top[i].y1 - top[i].y0) * heatmap_scale, top[i].peak);
+    }
+}
+
+void heatmapWrite(FILE* output, const char* processName, float time)
+{
+    int i;
+
+    for (i = 0; i < surfaceCount; i++)
+    {
+        struct Surface* s = &surfaces[i];
+        uint32_t maxCount = 0;
+        int cell;
+
+        for (cell = 0; cell < s->stride * s->height; cell++)
+        {
+            maxCount = s->cells[cell] > maxCount ? s->cells[cell] : maxCount;
+        }
+        if (!maxCount)
+        {
+            continue;
+        }
+
+        writeImage(s, maxCount);
+        printTopRegions(output, s, processName, time, maxCount);
+        memset(s->cells, 0, (size_t)s->stride * s->height * sizeof(uint32_t));
+    }
+
+    if (evictedSurfaces)
+    {
+        fprintf(output, "HEAT -- %.2f -- %s -- evicted_surfaces:%d\n",
+                time, processName, evictedSurfaces);
+        evictedSurfaces = 0;
+    }
+    dumpSerial++;
+}
+
+void heatmapCleanup(void)
+{
+    int i;
+
+    for (i = 0; i < surfaceCount; i++)
+    {
+        free(surfaces[i].cells);
+    }
+    memset(surfaces, 0, sizeof(surfaces));
+    surfaceCount = 0;
+    evictedSurfaces = 0;
+}
@@ -0,0 +1,52 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_HEATMAP_H
+#define SWAPLOGGER_HEATMAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct Rect;
+
+/**
+ *  Damage heatmap
+ *
+ *  Counts how often each screen region is repainted. Every swap's rects are
+ *  added to a grid with one cell per heatmap_scale x heatmap_scale pixels,
+ *  kept separately for each surface of each swap source. Up to 16 grids are
+ *  kept; the least recently updated one is dropped when a new surface
+ *  appears. heatmapWrite() saves each grid as a PGM image in
+ *  heatmap_directory, prints the heatmap_topRegions hottest regions and
+ *  clears the grids. A region is the bounding rectangle of neighbouring
+ *  cells repainted at least a tenth as often as the hottest cell.
+ */
+void heatmapAdd(const char* source, uintptr_t surface, int numRects,
+                const struct Rect* rects);
+void heatmapWrite(FILE* output, const char* processName, float time);
+void heatmapCleanup(void);
+
+extern int heatmap_scale;
+extern int heatmap_topRegions;
+extern const char* heatmap_directory;
+
+#endif /* SWAPLOGGER_HEATMAP_H */
@@ -0,0 +1,114 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger_histogram.h"
+
+#include <string.h>
+
+void histogramReset(struct Histogram* h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+void histogramAdd(struct Histogram* h, int64_t duration)
+{
+    int64_t bucket = duration / HISTOGRAM_BUCKET_NS;
+
+    if (bucket >= HISTOGRAM_BUCKETS)
+    {
+        bucket = HISTOGRAM_BUCKETS - 1;
+    }
+    h->buckets[bucket]++;
+
+    if (!h->frames || duration < h->minDuration)
+    {
+        h->minDuration = duration;
+    }
+    if (duration > h->maxDuration)
+    {
+        h->maxDuration = duration;
+    }
+    h->totalDuration += duration;
+    h->frames++;
+}
+
+void histogramMerge(struct Histogram* h, const struct Histogram* other)
+{
+    int i;
+
+    if (!other->frames)
+    {
+        return;
+    }
+    if (!h->frames || other->minDuration < h->minDuration)
+    {
+        h->minDuration = other->minDuration;
+    }
+    if (other->maxDuration > h->maxDuration)
+    {
+        h->maxDuration = other->maxDuration;
+    }
+    h->totalDuration += other->totalDuration;
+    h->frames += other->frames;
+
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        h->buckets[i] += other->buckets[i];
+    }
+}
+
+int64_t histogramPercentile(const struct Histogram* h, float percent)
+{
+    int64_t target = (int64_t)(h->frames * percent / 100.0f + 0.5f);
+    int64_t count = 0;
+    int i;
+
+    if (!h->frames)
+    {
+        return 0;
+    }
+    if (target < 1)
+    {
+        target = 1;
+    }
+
+    for (i = 0; i < HISTOGRAM_BUCKETS - 1; i++)
+    {
+        count += h->buckets[i];
+        if (count >= target)
+        {
+            /* Report the bucket's upper edge, clamped to the observed range */
+            int64_t duration = (int64_t)(i + 1) * HISTOGRAM_BUCKET_NS;
+            return duration < h->maxDuration ? duration : h->maxDuration;
+        }
+    }
+    return h->maxDuration;
+}
+
+float histogramAverageFps(const struct Histogram* h)
+{
+    if (!h->totalDuration)
+    {
+        return 0.0f;
+    }
+    return (1000.0f * 1000.0f * 1000.0f * h->frames) / h->totalDuration;
+}
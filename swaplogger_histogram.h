@@ -0,0 +1,57 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_HISTOGRAM_H
+#define SWAPLOGGER_HISTOGRAM_H
+
+#include <stdint.h>
+
+/** Frame durations are bucketed in quarter milliseconds up to 250 ms */
+#define HISTOGRAM_BUCKET_NS     (250 * 1000)
+#define HISTOGRAM_BUCKETS       1000
+
+/**
+ *  Frame duration histogram
+ *
+ *  Collects frame count, duration extremes and a fixed resolution
+ *  distribution from which percentiles are estimated.
+ */
+struct Histogram
+{
+    int frames;
+    int64_t totalDuration;
+    int64_t minDuration;
+    int64_t maxDuration;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogramReset(struct Histogram* h);
+void histogramAdd(struct Histogram* h, int64_t duration);
+void histogramMerge(struct Histogram* h, const struct Histogram* other);
+
+/** Frame duration in nanoseconds below which the given percent of frames fall */
+int64_t histogramPercentile(const struct Histogram* h, float percent);
+
+/** Average frames per second */
+float histogramAverageFps(const struct Histogram* h);
+
+#endif /* SWAPLOGGER_HISTOGRAM_H */
@@ -0,0 +1,62 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_MARKERS_H
+#define SWAPLOGGER_MARKERS_H
+
+/**
+ *  Application markers
+ *
+ *  Applications can split swap logger statistics into named phases, such as
+ *  "loading" or "scroll", by calling these functions. Frame statistics are
+ *  then reported separately for each phase.
+ *
+ *  The functions are weak references: when the application isn't run under
+ *  swap logger they resolve to NULL and the macros below do nothing. The
+ *  application must be built as a position independent executable or a
+ *  shared library for the references to be resolved at load time. No
+ *  linking against swap logger is needed.
+ *
+ *  The calls never block and may be made from any thread.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Start a phase. Any phase already in progress is ended. */
+void swaplogger_begin_phase(const char* name) __attribute__((weak));
+
+/** End the current phase */
+void swaplogger_end_phase(void) __attribute__((weak));
+
+#ifdef __cplusplus
+}
+#endif
+
+#define SWAPLOGGER_BEGIN_PHASE(name) \
+    do { if (swaplogger_begin_phase) swaplogger_begin_phase(name); } while (0)
+
+#define SWAPLOGGER_END_PHASE() \
+    do { if (swaplogger_end_phase) swaplogger_end_phase(); } while (0)
+
+#endif /* SWAPLOGGER_MARKERS_H */
@@ -0,0 +1,232 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger.h"
+#include "swaplogger_phase.h"
+#include "swaplogger_histogram.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PHASES          16
+#define MAX_PHASE_NAME      32
+#define MAX_REQUESTS        64
+#define MAX_SCHEDULE        32
+
+static struct
+{
+    char name[MAX_PHASE_NAME];
+    struct Histogram histogram;
+} phases[MAX_PHASES];
+
+static int phaseCount = 0;
+static int currentPhase = -1;
+
+/**
+ *  Queue of phase changes from the application. Writers reserve a slot by
+ *  advancing requestWrite and publish it by setting ready; the swapping
+ *  thread consumes slots in order.
+ */
+static struct
+{
+    volatile int ready;
+    int end;
+    char name[MAX_PHASE_NAME];
+} requests[MAX_REQUESTS];
+
+static unsigned int requestWrite = 0;
+static unsigned int requestRead = 0;
+static int droppedRequests = 0;
+
+static struct
+{
+    char name[MAX_PHASE_NAME];
+    int64_t time;
+} schedule[MAX_SCHEDULE];
+
+static int scheduleCount = 0;
+static int nextScheduled = 0;
+
+void phaseInit(const char* spec, int64_t baseTime)
+{
+    char entry[MAX_PHASE_NAME + 32];
+    const char* s = spec;
+
+    while (s && *s && scheduleCount < MAX_SCHEDULE)
+    {
+        size_t len = strcspn(s, ",");
+        char* at;
+
+        if (len < sizeof(entry))
+        {
+            memcpy(entry, s, len);
+            entry[len] = 0;
+            at = strchr(entry, '@');
+            if (at && at != entry && at - entry < MAX_PHASE_NAME)
+            {
+                *at = 0;
+                strcpy(schedule[scheduleCount].name, entry);
+                schedule[scheduleCount].time =
+                    baseTime + (int64_t)(atof(at + 1) * 1000.0 * 1000.0 * 1000.0);
+                scheduleCount++;
+            }
+            else
+            {
+                printInfo("Invalid phase schedule entry: %s", entry);
+            }
+        }
+        s += len;
+        if (*s == ',')
+        {
+            s++;
+        }
+    }
+}
+
+void phaseRequest(const char* name)
+{
+    unsigned int slot = __atomic_load_n(&requestWrite, __ATOMIC_RELAXED);
+
+    do
+    {
+        if (slot - __atomic_load_n(&requestRead, __ATOMIC_ACQUIRE) >= MAX_REQUESTS)
+        {
+            __atomic_add_fetch(&droppedRequests, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&requestWrite, &slot, slot + 1, 0,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    slot %= MAX_REQUESTS;
+    requests[slot].end = !name;
+    if (name)
+    {
+        strncpy(requests[slot].name, name, MAX_PHASE_NAME - 1);
+        requests[slot].name[MAX_PHASE_NAME - 1] = 0;
+    }
+    __atomic_store_n(&requests[slot].ready, 1, __ATOMIC_RELEASE);
+}
+
+SWAPLOGGER_EXPORT void swaplogger_begin_phase(const char* name)
+{
+    phaseRequest(name ? name : "");
+}
+
+SWAPLOGGER_EXPORT void swaplogger_end_phase(void)
+{
+    phaseRequest(NULL);
+}
+
+static void switchPhase(const char* name)
+{
+    int i;
+
+    if (!name || !strcmp(name, "-"))
+    {
+        currentPhase = -1;
+        return;
+    }
+
+    for (i = 0; i < phaseCount; i++)
+    {
+        if (!strcmp(phases[i].name, name))
+        {
+            currentPhase = i;
+            return;
+        }
+    }
+
+    if (phaseCount == MAX_PHASES)
+    {
+        printInfo("Too many phases, ignoring %s", name);
+        currentPhase = -1;
+        return;
+    }
+
+    strcpy(phases[phaseCount].name, name);
+    histogramReset(&phases[phaseCount].histogram);
+    currentPhase = phaseCount++;
+}
+
+void phaseUpdate(int64_t time, int64_t duration)
+{
+    unsigned int slot;
+
+    while (1)
+    {
+        slot = requestRead % MAX_REQUESTS;
+        if (!__atomic_load_n(&requests[slot].ready, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+        switchPhase(requests[slot].end ? NULL : requests[slot].name);
+        requests[slot].ready = 0;
+        __atomic_store_n(&requestRead, requestRead + 1, __ATOMIC_RELEASE);
+    }
+
+    while (nextScheduled < scheduleCount && schedule[nextScheduled].time <= time)
+    {
+        switchPhase(schedule[nextScheduled++].name);
+    }
+
+    if (currentPhase >= 0 && duration > 0)
+    {
+        histogramAdd(&phases[currentPhase].histogram, duration);
+    }
+}
+
+void phasePrint(FILE* output, const char* processName, float time)
+{
+    int i;
+
+    for (i = 0; i < phaseCount; i++)
+    {
+        const struct Histogram* h = &phases[i].histogram;
+
+        fprintf(output,
+                "PHSE -- %.2f -- %s -- phase:%s frames:%d min:%.2f max:%.2f afps:%.2f "
+                "dur_p50:%.2f dur_p90:%.2f dur_p99:%.2f\n",
+                time, processName, phases[i].name, h->frames,
+                framesPerSecond(h->maxDuration), framesPerSecond(h->minDuration),
+                histogramAverageFps(h),
+                milliseconds(histogramPercentile(h, 50.0f)),
+                milliseconds(histogramPercentile(h, 90.0f)),
+                milliseconds(histogramPercentile(h, 99.0f)));
+    }
+
+    if (droppedRequests)
+    {
+        fprintf(output, "PHSE -- %.2f -- %s -- dropped_markers:%d\n",
+                time, processName, droppedRequests);
+    }
+}
+
+void phaseReset(void)
+{
+    int i;
+
+    for (i = 0; i < phaseCount; i++)
+    {
+        histogramReset(&phases[i].histogram);
+    }
+}
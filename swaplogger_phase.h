@@ -0,0 +1,48 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_PHASE_H
+#define SWAPLOGGER_PHASE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ *  Per-phase statistics
+ *
+ *  Phases are started and ended by application markers (see
+ *  swaplogger_markers.h), control commands or a schedule given as a comma
+ *  separated list of name@seconds entries, where a name of "-" ends the
+ *  current phase. For example: "loading@0,scroll@5.5,-@20".
+ */
+void phaseInit(const char* schedule, int64_t baseTime);
+
+/** Queue a phase change without blocking. A NULL name ends the phase. */
+void phaseRequest(const char* name);
+
+/** Apply queued phase changes and count a frame; called with swapLock held */
+void phaseUpdate(int64_t time, int64_t duration);
+
+void phasePrint(FILE* output, const char* processName, float time);
+void phaseReset(void);
+
+#endif /* SWAPLOGGER_PHASE_H */
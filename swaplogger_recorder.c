@@ -0,0 +1,385 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger.h"
+#include "swaplogger_recorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* Enough for 60 seconds of history at 120 FPS */
+#define MAX_RECORDED_FRAMES     8192
+#define MAX_RECORDED_SECONDS    60.0f
+#define MAX_DUMPS_PER_MINUTE    64
+
+#define NSEC_PER_SEC            (1000LL * 1000LL * 1000LL)
+
+static void *writerThread(void *data);
+
+float record_preSeconds = 5.0f;
+float record_postSeconds = 2.0f;
+float record_maxDuration = 0.0f;
+float record_minFps = 0.0f;
+int record_maxDumpsPerMinute = 4;
+const char* record_directory = ".";
+
+struct Frame
+{
+    int64_t time;
+    int64_t duration;
+    const char* source;
+    int frame;
+};
+
+static struct
+{
+    const char* processName;
+    int64_t baseTime;
+
+    /** Ring buffer of recent frames, indexed by sequence number */
+    struct Frame* frames;
+    uint64_t frameCount;
+
+    /** Trigger state, owned by the swapping thread */
+    volatile int dumpRequested;
+    int triggered;
+    int64_t triggerTime;
+    char triggerReason[128];
+    int64_t dumpTimes[MAX_DUMPS_PER_MINUTE];
+    int dumpCount;
+    int droppedDumps;
+
+    /** Dump handed over to the writer thread */
+    struct Frame* dumpFrames;
+    int dumpFrameCount;
+    int64_t dumpTriggerTime;
+    char dumpReason[128];
+    int dumpTruncated;
+    int dumpPending;
+    int dumpSerial;
+
+    int done;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t writerThread;
+} recorder;
+
+int recorderInit(const char* processName, int64_t baseTime)
+{
+    memset(&recorder, 0, sizeof(recorder));
+    recorder.processName = processName;
+    recorder.baseTime = baseTime;
+
+    if (record_maxDumpsPerMinute > MAX_DUMPS_PER_MINUTE)
+    {
+        record_maxDumpsPerMinute = MAX_DUMPS_PER_MINUTE;
+    }
+
+    /* The whole window must fit in the ring when the dump is handed over */
+    record_preSeconds = record_preSeconds > 0 ? record_preSeconds : 0;
+    record_postSeconds = record_postSeconds > 0 ? record_postSeconds : 0;
+    if (record_preSeconds + record_postSeconds > MAX_RECORDED_SECONDS)
+    {
+        if (record_postSeconds > MAX_RECORDED_SECONDS)
+        {
+            record_postSeconds = MAX_RECORDED_SECONDS;
+        }
+        record_preSeconds = MAX_RECORDED_SECONDS - record_postSeconds;
+        printInfo("Flight recorder window limited to %.0f seconds, "
+                  "using %.2f s before and %.2f s after the trigger",
+                  MAX_RECORDED_SECONDS, record_preSeconds, record_postSeconds);
+    }
+
+    recorder.frames = calloc(MAX_RECORDED_FRAMES, sizeof(struct Frame));
+    recorder.dumpFrames = calloc(MAX_RECORDED_FRAMES, sizeof(struct Frame));
+    if (!recorder.frames || !recorder.dumpFrames)
+    {
+        printInfo("Unable to allocate flight recorder buffer");
+        goto out;
+    }
+
+    pthread_mutex_init(&recorder.lock, NULL);
+    pthread_cond_init(&recorder.cond, NULL);
+    if (pthread_create(&recorder.writerThread, NULL, writerThread, NULL))
+    {
+        printInfo("Unable to start flight recorder thread");
+        goto out;
+    }
+    return 1;
+
+out:
+    free(recorder.frames);
+    free(recorder.dumpFrames);
+    recorder.frames = recorder.dumpFrames = NULL;
+    return 0;
+}
+
+/**
+ *  Copy the frames inside the dump window to the writer thread. Returns
+ *  zero if the previous dump is still being written. The swapping thread
+ *  never blocks on the writer thread.
+ */
+static int handOver(void)
+{
+    int64_t startTime = recorder.triggerTime -
+                        (int64_t)(record_preSeconds * NSEC_PER_SEC);
+    uint64_t first = 0;
+    uint64_t seq;
+    int n = 0;
+
+    if (pthread_mutex_trylock(&recorder.lock))
+    {
+        return 0;
+    }
+    if (recorder.dumpPending)
+    {
+        pthread_mutex_unlock(&recorder.lock);
+        return 0;
+    }
+
+    if (recorder.frameCount > MAX_RECORDED_FRAMES)
+    {
+        first = recorder.frameCount - MAX_RECORDED_FRAMES;
+    }
+    seq = recorder.frameCount;
+    while (seq > first &&
+           recorder.frames[(seq - 1) % MAX_RECORDED_FRAMES].time >= startTime)
+    {
+        seq--;
+    }
+    for (; seq < recorder.frameCount; seq++)
+    {
+        recorder.dumpFrames[n++] = recorder.frames[seq % MAX_RECORDED_FRAMES];
+    }
+
+    /* At a high frame rate the ring may not reach back to startTime */
+    recorder.dumpTruncated = seq == first && first > 0;
+    recorder.dumpFrameCount = n;
+    recorder.dumpTriggerTime = recorder.triggerTime;
+    strcpy(recorder.dumpReason, recorder.triggerReason);
+    recorder.dumpPending = 1;
+    pthread_cond_signal(&recorder.cond);
+    pthread_mutex_unlock(&recorder.lock);
+    return 1;
+}
+
+/**
+ *  Start a dump window at the given frame unless the per-minute dump limit
+ *  has been reached.
+ */
+static void trigger(int64_t time, const char* reason)
+{
+    int recent = 0;
+    int i;
+
+    for (i = 0; i < recorder.dumpCount && i < MAX_DUMPS_PER_MINUTE; i++)
+    {
+        if (time - recorder.dumpTimes[i] < 60 * NSEC_PER_SEC)
+        {
+            recent++;
+        }
+    }
+    if (recent >= record_maxDumpsPerMinute)
+    {
+        recorder.droppedDumps++;
+        return;
+    }
+
+    recorder.dumpTimes[recorder.dumpCount++ % MAX_DUMPS_PER_MINUTE] = time;
+    recorder.triggered = 1;
+    recorder.triggerTime = time;
+    strncpy(recorder.triggerReason, reason, sizeof(recorder.triggerReason) - 1);
+}
+
+void recorderAddFrame(const char* source, int frame, int64_t time,
+                      int64_t duration, float movingAvgFps)
+{
+    struct Frame* f;
+
+    if (!recorder.frames)
+    {
+        return;
+    }
+
+    f = &recorder.frames[recorder.frameCount++ % MAX_RECORDED_FRAMES];
+    f->time = time;
+    f->duration = duration;
+    f->source = source;
+    f->frame = frame;
+
+    if (recorder.triggered)
+    {
+        if (time - recorder.triggerTime >= record_postSeconds * NSEC_PER_SEC)
+        {
+            if (!handOver())
+            {
+                recorder.droppedDumps++;
+            }
+            recorder.triggered = 0;
+        }
+        return;
+    }
+
+    if (recorder.dumpRequested)
+    {
+        recorder.dumpRequested = 0;
+        trigger(time, "request");
+    }
+    else if (record_maxDuration > 0 &&
+             milliseconds(duration) > record_maxDuration)
+    {
+        char reason[128];
+        snprintf(reason, sizeof(reason), "frame %d took %.2f ms",
+                 frame, milliseconds(duration));
+        trigger(time, reason);
+    }
+    else if (record_minFps > 0 && movingAvgFps > 0 &&
+             movingAvgFps < record_minFps)
+    {
+        char reason[128];
+        snprintf(reason, sizeof(reason), "average FPS %.2f at frame %d",
+                 movingAvgFps, frame);
+        trigger(time, reason);
+    }
+}
+
+void recorderRequestDump(void)
+{
+    recorder.dumpRequested = 1;
+}
+
+static void writeDump(void)
+{
+    char path[512];
+    char stamp[32];
+    time_t now = time(NULL);
+    struct tm tm;
+    FILE* file;
+    int i;
+
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, sizeof(path), "%s/swaplogger.%d.%s.%d.log",
+             record_directory, (int)getpid(), stamp, recorder.dumpSerial++);
+
+    file = fopen(path, "w");
+    if (!file)
+    {
+        perror("fopen");
+        return;
+    }
+
+    fprintf(file, "TRIG -- %.2f -- %s -- %s%s\n",
+            milliseconds(recorder.dumpTriggerTime - recorder.baseTime),
+            recorder.processName, recorder.dumpReason,
+            recorder.dumpTruncated ? " (history truncated)" : "");
+
+    for (i = 0; i < recorder.dumpFrameCount; i++)
+    {
+        const struct Frame* f = &recorder.dumpFrames[i];
+        fprintf(file, "%-4s -- %.2f -- %s -- frame:%d dur:%.2f%s\n",
+                f->source, milliseconds(f->time - recorder.baseTime),
+                recorder.processName, f->frame, milliseconds(f->duration),
+                f->time == recorder.dumpTriggerTime ? " trigger" : "");
+    }
+    fclose(file);
+}
+
+void *writerThread(void* data)
+{
+    (void)data;
+
+    pthread_mutex_lock(&recorder.lock);
+    while (1)
+    {
+        while (!recorder.dumpPending && !recorder.done)
+        {
+            pthread_cond_wait(&recorder.cond, &recorder.lock);
+        }
+        if (recorder.dumpPending)
+        {
+            pthread_mutex_unlock(&recorder.lock);
+            writeDump();
+            pthread_mutex_lock(&recorder.lock);
+            recorder.dumpPending = 0;
+        }
+        else if (recorder.done)
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&recorder.lock);
+
+    return NULL;
+}
+
+void recorderStop(void)
+{
+    if (!recorder.frames || recorder.done)
+    {
+        return;
+    }
+
+    /* The writer finishes a dump in progress before it exits */
+    pthread_mutex_lock(&recorder.lock);
+    recorder.done = 1;
+    pthread_cond_signal(&recorder.cond);
+    pthread_mutex_unlock(&recorder.lock);
+    pthread_join(recorder.writerThread, NULL);
+}
+
+void recorderCleanup(void)
+{
+    if (!recorder.frames)
+    {
+        return;
+    }
+    recorderStop();
+
+    /* Dumps handed over after the writer exited are written from here */
+    if (recorder.dumpPending)
+    {
+        writeDump();
+        recorder.dumpPending = 0;
+    }
+
+    /* Write out a dump whose post-trigger window was cut short */
+    if (recorder.triggered && handOver())
+    {
+        writeDump();
+        recorder.dumpPending = 0;
+        recorder.triggered = 0;
+    }
+
+    if (recorder.droppedDumps)
+    {
+        printInfo("Flight recorder dropped %d dumps", recorder.droppedDumps);
+    }
+
+    free(recorder.frames);
+    free(recorder.dumpFrames);
+    recorder.frames = recorder.dumpFrames = NULL;
+}
@@ -0,0 +1,62 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_RECORDER_H
+#define SWAPLOGGER_RECORDER_H
+
+#include <stdint.h>
+
+/**
+ *  Flight recorder
+ *
+ *  Keeps the most recent frames in memory and writes them to a file only
+ *  when a trigger fires: a frame longer than record_maxDuration, a moving
+ *  average FPS below record_minFps, or an explicit recorderRequestDump().
+ *  Each dump covers record_preSeconds before and record_postSeconds after
+ *  the trigger, together limited to 60 seconds by the size of the frame
+ *  ring. Files are written from a background thread.
+ */
+int recorderInit(const char* processName, int64_t baseTime);
+
+/**
+ *  Shutdown happens in two steps: recorderStop() joins the writer thread
+ *  and must be called without swapLock held, recorderCleanup() then writes
+ *  out any remaining dump with swapLock held.
+ */
+void recorderStop(void);
+void recorderCleanup(void);
+
+/** Called for every counted frame with swapLock held */
+void recorderAddFrame(const char* source, int frame, int64_t time,
+                      int64_t duration, float movingAvgFps);
+
+/** Async-signal-safe; the dump is triggered on the next frame */
+void recorderRequestDump(void);
+
+extern float record_preSeconds;
+extern float record_postSeconds;
+extern float record_maxDuration;
+extern float record_minFps;
+extern int record_maxDumpsPerMinute;
+extern const char* record_directory;
+
+#endif /* SWAPLOGGER_RECORDER_H */
@@ -0,0 +1,311 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger.h"
+#include "swaplogger_rollup.h"
+#include "swaplogger_histogram.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#define NSEC_PER_SEC        (1000LL * 1000LL * 1000LL)
+#define TIER_COUNT          (sizeof(tiers) / sizeof(tiers[0]))
+
+float rollup_jankDuration = 33.3f;
+int rollup_flushInterval = 10;
+
+/** Aggregate of one closed interval */
+struct Interval
+{
+    int64_t start;
+    int frames;
+    int jank;
+    int64_t minDuration;
+    int64_t maxDuration;
+    int64_t meanDuration;
+    int64_t p50, p90, p99;
+};
+
+static struct Tier
+{
+    /** Interval length in seconds */
+    int seconds;
+
+    /** Number of closed intervals kept in memory */
+    int capacity;
+
+    struct Interval* intervals;
+    uint64_t closed;
+    uint64_t flushed;
+    int lost;
+
+    /** Currently open interval */
+    int64_t start;
+    int jank;
+    struct Histogram histogram;
+} tiers[] =
+{
+    { .seconds = 1,    .capacity = 600 },
+    { .seconds = 10,   .capacity = 360 },
+    { .seconds = 60,   .capacity = 1440 },
+    { .seconds = 3600, .capacity = 168 },
+};
+
+static struct
+{
+    FILE* file;
+    const char* processName;
+    int64_t baseTime;
+
+    int done;
+    int running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t flushThread;
+} rollup = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static void *flushThread(void *data);
+
+int rollupInit(const char* path, const char* processName, int64_t baseTime)
+{
+    int i;
+
+    rollup.processName = processName;
+    rollup.baseTime = baseTime;
+
+    for (i = 0; i < TIER_COUNT; i++)
+    {
+        tiers[i].intervals = calloc(tiers[i].capacity, sizeof(struct Interval));
+        if (!tiers[i].intervals)
+        {
+            printInfo("Unable to allocate rollup storage");
+            goto out;
+        }
+        tiers[i].start = baseTime;
+        histogramReset(&tiers[i].histogram);
+    }
+
+    rollup.file = fopen(path, "w");
+    if (!rollup.file)
+    {
+        perror("fopen");
+        goto out;
+    }
+
+    if (pthread_create(&rollup.flushThread, NULL, flushThread, NULL))
+    {
+        goto out;
+    }
+    rollup.running = 1;
+    return 1;
+
+out:
+    rollupCleanup();
+    return 0;
+}
+
+/** Store the open interval of a tier and start the one containing time */
+static void closeInterval(struct Tier* tier, int64_t time)
+{
+    int64_t length = tier->seconds * NSEC_PER_SEC;
+    const struct Histogram* h = &tier->histogram;
+
+    if (h->frames)
+    {
+        struct Interval* i;
+
+        pthread_mutex_lock(&rollup.lock);
+        i = &tier->intervals[tier->closed % tier->capacity];
+        i->start = tier->start;
+        i->frames = h->frames;
+        i->jank = tier->jank;
+        i->minDuration = h->minDuration;
+        i->maxDuration = h->maxDuration;
+        i->meanDuration = h->totalDuration / h->frames;
+        i->p50 = histogramPercentile(h, 50.0f);
+        i->p90 = histogramPercentile(h, 90.0f);
+        i->p99 = histogramPercentile(h, 99.0f);
+        tier->closed++;
+        pthread_mutex_unlock(&rollup.lock);
+    }
+
+    histogramReset(&tier->histogram);
+    tier->jank = 0;
+    tier->start = rollup.baseTime + (time - rollup.baseTime) / length * length;
+}
+
+/**
+ *  Only the one second tier is updated per frame. Its histogram is merged
+ *  into the longer tiers when it closes.
+ */
+void rollupAddFrame(int64_t time, int64_t duration)
+{
+    int i;
+
+    if (!tiers[0].intervals)
+    {
+        return;
+    }
+
+    if (time - tiers[0].start >= NSEC_PER_SEC)
+    {
+        for (i = 1; i < TIER_COUNT; i++)
+        {
+            histogramMerge(&tiers[i].histogram, &tiers[0].histogram);
+            tiers[i].jank += tiers[0].jank;
+        }
+        closeInterval(&tiers[0], time);
+
+        for (i = 1; i < TIER_COUNT; i++)
+        {
+            if (time - tiers[i].start >= tiers[i].seconds * NSEC_PER_SEC)
+            {
+                closeInterval(&tiers[i], time);
+            }
+        }
+    }
+
+    if (duration > 0)
+    {
+        histogramAdd(&tiers[0].histogram, duration);
+        if (duration > rollup_jankDuration * 1000.0f * 1000.0f)
+        {
+            tiers[0].jank++;
+        }
+    }
+}
+
+/** Append intervals closed since the last flush to the rollup file */
+static void flush(void)
+{
+    struct Interval interval;
+    int i;
+
+    for (i = 0; i < TIER_COUNT; i++)
+    {
+        struct Tier* tier = &tiers[i];
+
+        pthread_mutex_lock(&rollup.lock);
+        if (tier->closed - tier->flushed > tier->capacity)
+        {
+            tier->lost += tier->closed - tier->flushed - tier->capacity;
+            tier->flushed = tier->closed - tier->capacity;
+        }
+        while (tier->flushed < tier->closed)
+        {
+            interval = tier->intervals[tier->flushed++ % tier->capacity];
+            pthread_mutex_unlock(&rollup.lock);
+
+            fprintf(rollup.file,
+                    "ROLL -- %.2f -- %s -- tier:%d frames:%d min:%.2f max:%.2f mean:%.2f "
+                    "p50:%.2f p90:%.2f p99:%.2f jank:%d\n",
+                    milliseconds(interval.start - rollup.baseTime),
+                    rollup.processName, tier->seconds, interval.frames,
+                    milliseconds(interval.minDuration),
+                    milliseconds(interval.maxDuration),
+                    milliseconds(interval.meanDuration),
+                    milliseconds(interval.p50), milliseconds(interval.p90),
+                    milliseconds(interval.p99), interval.jank);
+
+            pthread_mutex_lock(&rollup.lock);
+        }
+        pthread_mutex_unlock(&rollup.lock);
+    }
+    fflush(rollup.file);
+}
+
+void *flushThread(void* data)
+{
+    (void)data;
+
+    pthread_mutex_lock(&rollup.lock);
+    while (!rollup.done)
+    {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += rollup_flushInterval > 0 ? rollup_flushInterval : 1;
+        while (!rollup.done &&
+               pthread_cond_timedwait(&rollup.cond, &rollup.lock, &deadline) != ETIMEDOUT)
+        {
+        }
+
+        pthread_mutex_unlock(&rollup.lock);
+        flush();
+        pthread_mutex_lock(&rollup.lock);
+    }
+    pthread_mutex_unlock(&rollup.lock);
+
+    return NULL;
+}
+
+void rollupCleanup(void)
+{
+    int i;
+
+    if (rollup.running)
+    {
+        pthread_mutex_lock(&rollup.lock);
+        rollup.done = 1;
+        pthread_cond_signal(&rollup.cond);
+        pthread_mutex_unlock(&rollup.lock);
+        pthread_join(rollup.flushThread, NULL);
+        rollup.running = 0;
+
+        /* Write out the partial intervals still open */
+        for (i = 1; i < TIER_COUNT; i++)
+        {
+            histogramMerge(&tiers[i].histogram, &tiers[0].histogram);
+            tiers[i].jank += tiers[0].jank;
+        }
+        for (i = 0; i < TIER_COUNT; i++)
+        {
+            closeInterval(&tiers[i], tiers[i].start);
+        }
+        flush();
+
+        for (i = 0; i < TIER_COUNT; i++)
+        {
+            if (tiers[i].lost)
+            {
+                printInfo("Rollup tier %d s lost %d intervals",
+                          tiers[i].seconds, tiers[i].lost);
+            }
+        }
+    }
+
+    if (rollup.file)
+    {
+        fclose(rollup.file);
+        rollup.file = NULL;
+    }
+
+    for (i = 0; i < TIER_COUNT; i++)
+    {
+        free(tiers[i].intervals);
+        tiers[i].intervals = NULL;
+    }
+}
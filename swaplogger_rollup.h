@@ -0,0 +1,47 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_ROLLUP_H
+#define SWAPLOGGER_ROLLUP_H
+
+#include <stdint.h>
+
+/**
+ *  Time windowed rollups
+ *
+ *  Aggregates frames into consecutive 1 second, 10 second, 1 minute and
+ *  1 hour intervals. Each tier keeps its most recent intervals in a fixed
+ *  size ring, and a background thread appends newly closed intervals to
+ *  the rollup file every rollup_flushInterval seconds. Memory use doesn't
+ *  grow with the length of the run.
+ */
+int rollupInit(const char* path, const char* processName, int64_t baseTime);
+void rollupCleanup(void);
+
+/** Called for every counted frame with swapLock held */
+void rollupAddFrame(int64_t time, int64_t duration);
+
+/** Frames longer than this many milliseconds are counted as jank */
+extern float rollup_jankDuration;
+extern int rollup_flushInterval;
+
+#endif /* SWAPLOGGER_ROLLUP_H */
@@ -0,0 +1,354 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#include "swaplogger.h"
+#include "swaplogger_sampler.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define MAX_COUNTERS    96
+#define MAX_CPUS        64
+#define MAX_ZONES       32
+
+#define NSEC_PER_SEC    (1000LL * 1000LL * 1000LL)
+
+static void *samplerThread(void *data);
+
+int sampler_interval = 100;
+
+enum CounterType
+{
+    COUNTER_CPUFREQ,
+    COUNTER_THERMAL,
+    COUNTER_PRESSURE,
+};
+
+struct Counter
+{
+    char name[40];
+    enum CounterType type;
+    int fd;
+};
+
+static struct
+{
+    FILE* file;
+    const char* processName;
+    int64_t baseTime;
+
+    struct Counter counters[MAX_COUNTERS];
+    int counterCount;
+    int statmFd;
+    int statFd;
+    long pageSize;
+    long ticksPerSecond;
+
+    /** Process CPU time at the previous sample */
+    unsigned long long lastTicks;
+    int64_t lastTime;
+
+    int done;
+    int running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} sampler = { .statmFd = -1, .statFd = -1,
+              .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static void addCounter(const char* path, const char* name, enum CounterType type)
+{
+    struct Counter* c;
+    int fd;
+
+    if (sampler.counterCount >= MAX_COUNTERS)
+    {
+        return;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    c = &sampler.counters[sampler.counterCount++];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->type = type;
+    c->fd = fd;
+}
+
+/** Read a whole small file kept open between samples */
+static int readFile(int fd, char* data, size_t size)
+{
+    ssize_t len = pread(fd, data, size - 1, 0);
+
+    if (len <= 0)
+    {
+        return 0;
+    }
+    data[len] = 0;
+    return 1;
+}
+
+static void findCounters(void)
+{
+    char path[128];
+    char name[40];
+    char type[32];
+    int fd;
+    int i;
+
+    for (i = 0; i < MAX_CPUS; i++)
+    {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", i);
+        snprintf(name, sizeof(name), "cpu%d_mhz", i);
+        addCounter(path, name, COUNTER_CPUFREQ);
+    }
+
+    for (i = 0; i < MAX_ZONES; i++)
+    {
+        snprintf(path, sizeof(path), "/sys/class/thermal/thermal_zone%d/type", i);
+        snprintf(name, sizeof(name), "zone%d_c", i);
+
+        /* Name the zone after its type, e.g. cpu-thermal, when possible */
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            if (readFile(fd, type, sizeof(type)))
+            {
+                type[strcspn(type, "\n")] = 0;
+                snprintf(name, sizeof(name), "%s_c", type);
+            }
+            close(fd);
+        }
+
+        snprintf(path, sizeof(path), "/sys/class/thermal/thermal_zone%d/temp", i);
+        addCounter(path, name, COUNTER_THERMAL);
+    }
+
+    addCounter("/proc/pressure/cpu", "psi_cpu", COUNTER_PRESSURE);
+    addCounter("/proc/pressure/memory", "psi_memory", COUNTER_PRESSURE);
+    addCounter("/proc/pressure/io", "psi_io", COUNTER_PRESSURE);
+}
+
+int samplerInit(const char* path, const char* processName, int64_t baseTime)
+{
+    sampler.processName = processName;
+    sampler.baseTime = baseTime;
+    sampler.pageSize = sysconf(_SC_PAGESIZE);
+    sampler.ticksPerSecond = sysconf(_SC_CLK_TCK);
+    if (sampler_interval <= 0)
+    {
+        sampler_interval = 100;
+    }
+
+    sampler.file = fopen(path, "w");
+    if (!sampler.file)
+    {
+        perror("fopen");
+        goto out;
+    }
+    setvbuf(sampler.file, NULL, _IOLBF, 0);
+
+    findCounters();
+    sampler.statmFd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    sampler.statFd = open("/proc/self/stat", O_RDONLY | O_CLOEXEC);
+
+    if (pthread_create(&sampler.thread, NULL, samplerThread, NULL))
+    {
+        goto out;
+    }
+    sampler.running = 1;
+    return 1;
+
+out:
+    samplerCleanup();
+    return 0;
+}
+
+/** Sum of the user and system CPU time of the process in clock ticks */
+static int readCpuTicks(unsigned long long* ticks)
+{
+    char stat[1024];
+    const char* fields;
+    unsigned long long utime, stime;
+    int i;
+
+    if (sampler.statFd < 0 || !readFile(sampler.statFd, stat, sizeof(stat)))
+    {
+        return 0;
+    }
+
+    /* Advance past the command name to the space in front of field 14 */
+    fields = strrchr(stat, ')');
+    for (i = 0; i < 12 && fields; i++)
+    {
+        fields = strchr(fields + 1, ' ');
+    }
+    if (!fields || sscanf(fields, " %llu %llu", &utime, &stime) != 2)
+    {
+        return 0;
+    }
+    *ticks = utime + stime;
+    return 1;
+}
+
+static void sample(void)
+{
+    char data[256];
+    int64_t time = getTime();
+    unsigned long long ticks;
+    unsigned long size, resident;
+    int i;
+
+    fprintf(sampler.file, "SYS  -- %.2f -- %s --",
+            (time - sampler.baseTime) / (1000.0f * 1000.0f), sampler.processName);
+
+    for (i = 0; i < sampler.counterCount; i++)
+    {
+        const struct Counter* c = &sampler.counters[i];
+        const char* avg10;
+
+        if (!readFile(c->fd, data, sizeof(data)))
+        {
+            continue;
+        }
+
+        switch (c->type)
+        {
+        case COUNTER_CPUFREQ:
+            fprintf(sampler.file, " %s:%ld", c->name, atol(data) / 1000);
+            break;
+        case COUNTER_THERMAL:
+            fprintf(sampler.file, " %s:%.1f", c->name, atol(data) / 1000.0f);
+            break;
+        case COUNTER_PRESSURE:
+            /* Share of the last 10 seconds some task was stalled */
+            avg10 = strstr(data, "avg10=");
+            if (avg10)
+            {
+                fprintf(sampler.file, " %s:%.2f", c->name, atof(avg10 + 6));
+            }
+            break;
+        }
+    }
+
+    if (sampler.statmFd >= 0 && readFile(sampler.statmFd, data, sizeof(data)) &&
+        sscanf(data, "%lu %lu", &size, &resident) == 2)
+    {
+        fprintf(sampler.file, " rss_kb:%lu", resident * (sampler.pageSize / 1024));
+    }
+
+    /* Process CPU usage since the previous sample, 100 per fully used core */
+    if (readCpuTicks(&ticks))
+    {
+        if (sampler.lastTime && time > sampler.lastTime)
+        {
+            float seconds = (time - sampler.lastTime) / (float)NSEC_PER_SEC;
+            fprintf(sampler.file, " cpu:%.1f",
+                    100.0f * (ticks - sampler.lastTicks) /
+                    sampler.ticksPerSecond / seconds);
+        }
+        sampler.lastTicks = ticks;
+        sampler.lastTime = time;
+    }
+
+    fprintf(sampler.file, "\n");
+}
+
+void *samplerThread(void* data)
+{
+    struct timespec deadline;
+    (void)data;
+
+    /* Stay out of the way of the application's own threads */
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    pthread_mutex_lock(&sampler.lock);
+    while (!sampler.done)
+    {
+        pthread_mutex_unlock(&sampler.lock);
+        sample();
+        pthread_mutex_lock(&sampler.lock);
+
+        deadline.tv_nsec += sampler_interval * 1000LL * 1000LL;
+        deadline.tv_sec += deadline.tv_nsec / NSEC_PER_SEC;
+        deadline.tv_nsec %= NSEC_PER_SEC;
+        while (!sampler.done &&
+               pthread_cond_timedwait(&sampler.cond, &sampler.lock, &deadline) != ETIMEDOUT)
+        {
+        }
+    }
+    pthread_mutex_unlock(&sampler.lock);
+
+    return NULL;
+}
+
+void samplerCleanup(void)
+{
+    int i;
+
+    if (sampler.running)
+    {
+        pthread_mutex_lock(&sampler.lock);
+        sampler.done = 1;
+        pthread_cond_signal(&sampler.cond);
+        pthread_mutex_unlock(&sampler.lock);
+        pthread_join(sampler.thread, NULL);
+        sampler.running = 0;
+    }
+
+    for (i = 0; i < sampler.counterCount; i++)
+    {
+        close(sampler.counters[i].fd);
+    }
+    sampler.counterCount = 0;
+
+    if (sampler.statmFd >= 0)
+    {
+        close(sampler.statmFd);
+        sampler.statmFd = -1;
+    }
+    if (sampler.statFd >= 0)
+    {
+        close(sampler.statFd);
+        sampler.statFd = -1;
+    }
+
+    if (sampler.file)
+    {
+        fclose(sampler.file);
+        sampler.file = NULL;
+    }
+}
@@ -0,0 +1,42 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+#ifndef SWAPLOGGER_SAMPLER_H
+#define SWAPLOGGER_SAMPLER_H
+
+#include <stdint.h>
+
+/**
+ *  System context sampler
+ *
+ *  Samples CPU frequencies, thermal zone temperatures, pressure stall
+ *  information and the process's memory and CPU usage every
+ *  sampler_interval milliseconds on a low priority thread, and writes
+ *  them to a file as SYS lines. Times use the same base as the frame
+ *  lines so the two can be lined up.
+ */
+int samplerInit(const char* path, const char* processName, int64_t baseTime);
+void samplerCleanup(void);
+
+extern int sampler_interval;
+
+#endif /* SWAPLOGGER_SAMPLER_H */
@@ -25,41 +25,75 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 
 #include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#include <X11/Xatom.h>
 #include <X11/extensions/Xdamage.h>
 
+/* Size of the window table; must be a power of two */
+#define MAX_WINDOWS         1024
+#define MAX_PRINTED_WINDOWS 16
+#define MAX_WINDOW_NAME     64
+
 static void *eventThread(void *data);
+static void disconnectDisplay(void);
+static int handleError(Display* dpy, xError* error, XExtCodes* codes, int* ret);
+static void trackExistingWindows(void);
 
 int count_XDamage = 1;
+int track_XDamageWindows = 0;
+
+/** Damage statistics of a top-level window */
+struct TrackedWindow
+{
+    Window window;
+    Damage damage;
+    unsigned long pid;
+    char name[MAX_WINDOW_NAME];
+    int updates;
+    uint64_t area;
+};
 
 struct {
     Display* dpy;
     Damage damage;
     int eventBase;
     int done;
+    int running;
 
     pthread_t eventThread;
+
+    /** Top-level windows, hashed by window id with linear probing */
+    struct TrackedWindow windows[MAX_WINDOWS];
+    int windowCount;
+    int64_t windowStatsStart;
+    Atom pidAtom;
+    pthread_mutex_t windowLock;
 } damage;
 
-int damageInit(void)
+/**
+ *  Connect to the display and create the damage handle. This runs on the
+ *  event thread so that the application's startup isn't delayed by it.
+ */
+static int connectDisplay(void)
 {
     int errBase;
 
-    memset(&damage, 0, sizeof(damage));
-
     damage.dpy = XOpenDisplay(NULL);
 
     if (!damage.dpy)
     {
-        printf("Unable to open display\n");
+        printInfo("Unable to open display");
         goto out;
     }
 
     if (!XDamageQueryExtension(damage.dpy, &damage.eventBase, &errBase))
     {
-        printf("Damage extension not supported\n");
+        printInfo("Damage extension not supported");
         goto out;
     }
 
@@ -67,39 +101,291 @@ int damageInit(void)
                                   XDamageReportNonEmpty);
     if (!damage.damage)
     {
-        printf("Unable to create damage handle\n");
+        printInfo("Unable to create damage handle");
         goto out;
     }
 
-    pthread_create(&damage.eventThread, NULL, eventThread, NULL);
+    if (track_XDamageWindows)
+    {
+        XExtCodes* codes = XAddExtension(damage.dpy);
+
+        if (!codes)
+        {
+            printInfo("Unable to install X error hook");
+            goto out;
+        }
+        XESetError(damage.dpy, codes->extension, handleError);
+        damage.pidAtom = XInternAtom(damage.dpy, "_NET_WM_PID", False);
+        XSelectInput(damage.dpy, XDefaultRootWindow(damage.dpy),
+                     SubstructureNotifyMask);
+        trackExistingWindows();
+    }
     return 1;
 
 out:
-    damageCleanup();
+    printInfo("Unable to initialize X damage tracking");
+    disconnectDisplay();
     return 0;
 }
 
-void damageCleanup(void)
+static void disconnectDisplay(void)
 {
-    damage.done = 1;
-    pthread_join(damage.eventThread, NULL);
-
     if (damage.damage)
     {
         XDamageDestroy(damage.dpy, damage.damage);
+        damage.damage = 0;
     }
 
     if (damage.dpy)
     {
         XCloseDisplay(damage.dpy);
+        damage.dpy = NULL;
+    }
+}
+
+/**
+ *  Windows can disappear before damage is created for them. This hook is
+ *  registered only on our own connection, where it swallows all errors
+ *  before they reach the process-wide error handler, which belongs to the
+ *  application.
+ */
+static int handleError(Display* dpy, xError* error, XExtCodes* codes, int* ret)
+{
+    *ret = 0;
+    return True;
+}
+
+static struct TrackedWindow* findWindow(Window window, int insert)
+{
+    unsigned int i = (window * 2654435761u) & (MAX_WINDOWS - 1);
+
+    while (damage.windows[i].window)
+    {
+        if (damage.windows[i].window == window)
+        {
+            return &damage.windows[i];
+        }
+        i = (i + 1) & (MAX_WINDOWS - 1);
+    }
+
+    /* Keep at least one empty slot so lookups terminate */
+    if (!insert || damage.windowCount == MAX_WINDOWS - 1)
+    {
+        return NULL;
+    }
+    memset(&damage.windows[i], 0, sizeof(damage.windows[i]));
+    damage.windows[i].window = window;
+    damage.windowCount++;
+    return &damage.windows[i];
+}
+
+/** Remove a table entry, shifting back any entries that probed past it */
+static void removeWindow(struct TrackedWindow* w)
+{
+    unsigned int hole = w - damage.windows;
+    unsigned int i = hole;
+
+    memset(w, 0, sizeof(*w));
+    damage.windowCount--;
+
+    while (1)
+    {
+        unsigned int home;
+
+        i = (i + 1) & (MAX_WINDOWS - 1);
+        if (!damage.windows[i].window)
+        {
+            break;
+        }
+        home = (damage.windows[i].window * 2654435761u) & (MAX_WINDOWS - 1);
+        if (((i - home) & (MAX_WINDOWS - 1)) >= ((i - hole) & (MAX_WINDOWS - 1)))
+        {
+            damage.windows[hole] = damage.windows[i];
+            memset(&damage.windows[i], 0, sizeof(damage.windows[i]));
+            hole = i;
+        }
+    }
+}
+
+/** Look up the window title and owning process. Called on the event thread. */
+static void describeWindow(struct TrackedWindow* w)
+{
+    char* name = NULL;
+    Atom type;
+    int format;
+    unsigned long items, remaining;
+    unsigned char* data = NULL;
+
+    if (XFetchName(damage.dpy, w->window, &name) && name)
+    {
+        pthread_mutex_lock(&damage.windowLock);
+        snprintf(w->name, sizeof(w->name), "%s", name);
+        pthread_mutex_unlock(&damage.windowLock);
+        XFree(name);
+    }
+
+    if (XGetWindowProperty(damage.dpy, w->window, damage.pidAtom, 0, 1, False,
+                           XA_CARDINAL, &type, &format, &items, &remaining,
+                           &data) == Success && data)
+    {
+        if (type == XA_CARDINAL && format == 32 && items == 1)
+        {
+            w->pid = *(unsigned long*)data;
+        }
+        XFree(data);
+    }
+}
+
+static void trackWindow(Window window)
+{
+    struct TrackedWindow* w;
+
+    pthread_mutex_lock(&damage.windowLock);
+    w = findWindow(window, 1);
+    if (w && !w->damage)
+    {
+        w->damage = XDamageCreate(damage.dpy, window, XDamageReportBoundingBox);
+    }
+    pthread_mutex_unlock(&damage.windowLock);
+
+    if (w)
+    {
+        describeWindow(w);
     }
 }
 
+static void untrackWindow(Window window, int destroyed)
+{
+    struct TrackedWindow* w;
+
+    pthread_mutex_lock(&damage.windowLock);
+    w = findWindow(window, 0);
+    if (w)
+    {
+        /* The server frees the damage object of a destroyed window */
+        if (!destroyed && w->damage)
+        {
+            XDamageDestroy(damage.dpy, w->damage);
+        }
+        removeWindow(w);
+    }
+    pthread_mutex_unlock(&damage.windowLock);
+}
+
+static void trackExistingWindows(void)
+{
+    Window root, parent;
+    Window* children = NULL;
+    unsigned int count = 0;
+    unsigned int i;
+
+    if (XQueryTree(damage.dpy, XDefaultRootWindow(damage.dpy),
+                   &root, &parent, &children, &count))
+    {
+        for (i = 0; i < count; i++)
+        {
+            trackWindow(children[i]);
+        }
+        XFree(children);
+    }
+}
+
+void damageReset(void)
+{
+    int i;
+
+    pthread_mutex_lock(&damage.windowLock);
+    for (i = 0; i < MAX_WINDOWS; i++)
+    {
+        damage.windows[i].updates = 0;
+        damage.windows[i].area = 0;
+    }
+    damage.windowStatsStart = getMonotonicTime();
+    pthread_mutex_unlock(&damage.windowLock);
+}
+
+void damagePrintWindows(FILE* output, const char* processName, float time)
+{
+    struct TrackedWindow sorted[MAX_PRINTED_WINDOWS + 1];
+    float seconds;
+    int count = 0;
+    int i, j;
+
+    if (!track_XDamageWindows)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&damage.windowLock);
+    seconds = (getMonotonicTime() - damage.windowStatsStart) / (1000.0f * 1000.0f * 1000.0f);
+    for (i = 0; i < MAX_WINDOWS; i++)
+    {
+        if (!damage.windows[i].window || !damage.windows[i].updates)
+        {
+            continue;
+        }
+        /* Keep the busiest windows, dropping the least busy one when full */
+        for (j = count; j > 0 && sorted[j - 1].updates < damage.windows[i].updates; j--)
+        {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = damage.windows[i];
+        if (count < MAX_PRINTED_WINDOWS)
+        {
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&damage.windowLock);
+
+    for (i = 0; i < count; i++)
+    {
+        fprintf(output,
+                "WDMG -- %.2f -- %s -- window:0x%lx pid:%lu name:%s updates:%d rate:%.2f area:%llu\n",
+                time, processName, sorted[i].window, sorted[i].pid,
+                sorted[i].name[0] ? sorted[i].name : "-", sorted[i].updates,
+                seconds > 0 ? sorted[i].updates / seconds : 0.0f,
+                (unsigned long long)sorted[i].area);
+    }
+}
+
+int damageInit(void)
+{
+    memset(&damage, 0, sizeof(damage));
+    pthread_mutex_init(&damage.windowLock, NULL);
+    damage.windowStatsStart = getMonotonicTime();
+
+    if (pthread_create(&damage.eventThread, NULL, eventThread, NULL))
+    {
+        return 0;
+    }
+    damage.running = 1;
+    return 1;
+}
+
+void damageCleanup(void)
+{
+    damage.done = 1;
+    if (damage.running)
+    {
+        pthread_join(damage.eventThread, NULL);
+        damage.running = 0;
+    }
+
+    disconnectDisplay();
+}
+
 void *eventThread(void* data)
 {
     (void)data;
     XEvent event;
 
+    swapLoggerThread = 1;
+
+    if (!connectDisplay())
+    {
+        return NULL;
+    }
+
     while (!damage.done)
     {
         if (XNextEvent(damage.dpy, &event) == 0)
@@ -107,17 +393,53 @@ void *eventThread(void* data)
             if (event.type == damage.eventBase + XDamageNotify)
             {
                 const XDamageNotifyEvent* e = (const XDamageNotifyEvent*)&event;
-                if (count_XDamage)
+                if (e->damage != damage.damage)
+                {
+                    struct TrackedWindow* w;
+
+                    pthread_mutex_lock(&damage.windowLock);
+                    w = findWindow(e->drawable, 0);
+                    if (w)
+                    {
+                        w->updates++;
+                        w->area += (uint64_t)e->area.width * e->area.height;
+                    }
+                    pthread_mutex_unlock(&damage.windowLock);
+                }
+                else if (count_XDamage)
                 {
                     struct Rect rect =
                     {
                         .x = e->geometry.x,     .y = e->geometry.y,
                         .w = e->geometry.width, .h = e->geometry.height
                     };
-                    registerSwap("XDMG", 1, &rect);
+                    registerSwap("XDMG", e->drawable, 1, &rect);
                 }
                 XDamageSubtract(damage.dpy, e->damage, None, None);
             }
+            else if (event.type == CreateNotify)
+            {
+                trackWindow(event.xcreatewindow.window);
+            }
+            else if (event.type == MapNotify)
+            {
+                trackWindow(event.xmap.window);
+            }
+            else if (event.type == DestroyNotify)
+            {
+                untrackWindow(event.xdestroywindow.window, 1);
+            }
+            else if (event.type == ReparentNotify)
+            {
+                if (event.xreparent.parent == XDefaultRootWindow(damage.dpy))
+                {
+                    trackWindow(event.xreparent.window);
+                }
+                else
+                {
+                    untrackWindow(event.xreparent.window, 0);
+                }
+            }
         }
     }
 
@@ -23,9 +23,16 @@
 #ifndef SWAPLOGGER_XDAMAGE_H
 #define SWAPLOGGER_XDAMAGE_H
 
+#include <stdio.h>
+
 int damageInit(void);
 void damageCleanup(void);
 
+/** Per-window damage statistics, collected if track_XDamageWindows is set */
+void damageReset(void);
+void damagePrintWindows(FILE* output, const char* processName, float time);
+
 extern int count_XDamage;
+extern int track_XDamageWindows;
 
 #endif /* SWAPLOGGER_XDAMAGE_H */
@@ -24,18 +24,78 @@
 #include "swaplogger_xshm.h"
 
 #include <X11/Xlib.h>
+#include <X11/Xlibint.h>
 #include <X11/extensions/XShm.h>
 
 #include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <dlfcn.h>
+#include <pthread.h>
+
+#define MAX_PENDING_PUTS    256
+#define MAX_DISPLAYS        4
 
 typedef Status (*XShmPutImage_ptr)(Display* display, Drawable d, GC gc, XImage*
         image, int src_x, int src_y, int dest_x, int dest_y, unsigned int
         width, unsigned int height, Bool send_event);
+typedef int (*XShmGetEventBase_ptr)(Display* display);
+typedef Bool (*WireToEvent_ptr)(Display* display, XEvent* re, xEvent* event);
 
 static void* xextLibrary = 0;
 static XShmPutImage_ptr real_XShmPutImage = 0;
+static XShmGetEventBase_ptr real_XShmGetEventBase = 0;
 int count_XSHMPutImage = 1;
+int force_ShmCompletion = 0;
+
+/**
+ *  Upload statistics
+ *
+ *  Completion latency is measured from the XShmPutImage call until Xlib
+ *  reads the matching ShmCompletion event, so it includes any delay in the
+ *  application's event processing.
+ */
+static struct
+{
+    pthread_mutex_t lock;
+
+    int puts;
+    uint64_t bytes;
+    int64_t firstPut;
+    int64_t lastPut;
+
+    int completions;
+    int64_t totalLatency;
+    int64_t minLatency;
+    int64_t maxLatency;
+
+    /**
+     *  Puts waiting for a completion event. Events carry the drawable,
+     *  segment and offset of the put they complete, and arrive in request
+     *  order, so the oldest pending put with the same values is the match.
+     *  A slot is free when its display is NULL.
+     */
+    struct
+    {
+        Display* display;
+        Drawable drawable;
+        ShmSeg shmseg;
+        unsigned long offset;
+        uint64_t sequence;
+        int64_t time;
+        Bool forced;
+    } pending[MAX_PENDING_PUTS];
+    uint64_t nextSequence;
+
+    /** Displays with a completion event hook installed */
+    struct
+    {
+        Display* display;
+        WireToEvent_ptr chained;
+    } displays[MAX_DISPLAYS];
+    int displayCount;
+} upload = { .lock = PTHREAD_MUTEX_INITIALIZER };
 
 int xshmInit(void)
 {
@@ -46,6 +106,7 @@ int xshmInit(void)
         printf("Unable to look up XShmPutImage");
         return 0;
     }
+    real_XShmGetEventBase = (XShmGetEventBase_ptr)dlsym(xextLibrary, "XShmGetEventBase");
     return 1;
 }
 
@@ -54,13 +115,251 @@ void xshmCleanup(void)
     dlclose(xextLibrary);
 }
 
-Status XShmPutImage(Display* display, Drawable d, GC gc, XImage* image,
+/** Find the oldest pending put completed by e, or -1. Needs upload.lock. */
+static int findPending(Display* display, const XShmCompletionEvent* e)
+{
+    int match = -1;
+    int i;
+
+    for (i = 0; i < MAX_PENDING_PUTS; i++)
+    {
+        if (upload.pending[i].display == display &&
+            upload.pending[i].drawable == e->drawable &&
+            upload.pending[i].shmseg == e->shmseg &&
+            upload.pending[i].offset == e->offset &&
+            (match < 0 || upload.pending[i].sequence < upload.pending[match].sequence))
+        {
+            match = i;
+        }
+    }
+    return match;
+}
+
+/**
+ *  Wire to event hook for ShmCompletion. Runs inside Xlib with the display
+ *  locked, so it must not make any Xlib calls.
+ */
+static Bool completionHook(Display* display, XEvent* re, xEvent* event)
+{
+    const XShmCompletionEvent* e = (const XShmCompletionEvent*)re;
+    WireToEvent_ptr chained = NULL;
+    Bool result;
+    int match;
+    int i;
+
+    pthread_mutex_lock(&upload.lock);
+    for (i = 0; i < upload.displayCount; i++)
+    {
+        if (upload.displays[i].display == display)
+        {
+            chained = upload.displays[i].chained;
+        }
+    }
+    pthread_mutex_unlock(&upload.lock);
+
+    if (!chained)
+    {
+        return False;
+    }
+    result = chained(display, re, event);
+
+    pthread_mutex_lock(&upload.lock);
+    match = findPending(display, e);
+    if (match >= 0)
+    {
+        int64_t latency = getMonotonicTime() - upload.pending[match].time;
+
+        if (!upload.completions || latency < upload.minLatency)
+        {
+            upload.minLatency = latency;
+        }
+        if (latency > upload.maxLatency)
+        {
+            upload.maxLatency = latency;
+        }
+        upload.totalLatency += latency;
+        upload.completions++;
+
+        /* Don't deliver completions the application didn't ask for */
+        if (upload.pending[match].forced)
+        {
+            result = False;
+        }
+
+        /* Older puts on this display failed and will never complete */
+        for (i = 0; i < MAX_PENDING_PUTS; i++)
+        {
+            if (upload.pending[i].display == display &&
+                upload.pending[i].sequence <= upload.pending[match].sequence)
+            {
+                upload.pending[i].display = NULL;
+            }
+        }
+    }
+    pthread_mutex_unlock(&upload.lock);
+
+    return result;
+}
+
+/**
+ *  Make sure completionHook() sees the ShmCompletion events of display.
+ *  The event vector is swapped with the display locked, the same way
+ *  XESetWireToEvent() does it, so the hook can't run before the chained
+ *  handler is known. Lock order is the display first, then upload.lock.
+ *  Returns zero if the hook couldn't be installed.
+ */
+static int installCompletionHook(Display* display)
+{
+    int installed;
+    int code;
+    int i;
+
+    if (!real_XShmGetEventBase)
+    {
+        return 0;
+    }
+    code = real_XShmGetEventBase(display) + ShmCompletion;
+    if (code < 0 || code >= 128)
+    {
+        return 0;
+    }
+
+    LockDisplay(display);
+    pthread_mutex_lock(&upload.lock);
+
+    if (display->event_vec[code] != completionHook)
+    {
+        /* A display that was closed may have left an entry at this address */
+        for (i = 0; i < upload.displayCount; i++)
+        {
+            if (upload.displays[i].display == display)
+            {
+                break;
+            }
+        }
+        if (i == upload.displayCount && i < MAX_DISPLAYS)
+        {
+            upload.displayCount++;
+        }
+        if (i < upload.displayCount)
+        {
+            upload.displays[i].display = display;
+            upload.displays[i].chained = display->event_vec[code];
+            display->event_vec[code] = completionHook;
+        }
+    }
+    installed = display->event_vec[code] == completionHook;
+
+    pthread_mutex_unlock(&upload.lock);
+    UnlockDisplay(display);
+    return installed;
+}
+
+/**
+ *  Count a put and, if trackCompletion is set, remember it until its
+ *  completion event arrives. Returns the pending slot, or -1 if the put
+ *  isn't tracked, e.g. because the pending table is full.
+ */
+static int recordPut(Display* display, Drawable d, const XImage* image,
+                     unsigned int height, Bool trackCompletion, Bool forced)
+{
+    const XShmSegmentInfo* shminfo = (const XShmSegmentInfo*)image->obdata;
+    int64_t now = getMonotonicTime();
+    int slot = -1;
+    int i;
+
+    pthread_mutex_lock(&upload.lock);
+
+    if (!upload.puts)
+    {
+        upload.firstPut = now;
+    }
+    upload.lastPut = now;
+    upload.puts++;
+    upload.bytes += (uint64_t)image->bytes_per_line * height;
+
+    for (i = 0; trackCompletion && shminfo && i < MAX_PENDING_PUTS; i++)
+    {
+        if (!upload.pending[i].display)
+        {
+            slot = i;
+            upload.pending[i].display = display;
+            upload.pending[i].drawable = d;
+            upload.pending[i].shmseg = shminfo->shmseg;
+            upload.pending[i].offset = image->data - shminfo->shmaddr;
+            upload.pending[i].sequence = upload.nextSequence++;
+            upload.pending[i].time = now;
+            upload.pending[i].forced = forced;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&upload.lock);
+    return slot;
+}
+
+static void cancelPut(int slot)
+{
+    pthread_mutex_lock(&upload.lock);
+    upload.pending[slot].display = NULL;
+    pthread_mutex_unlock(&upload.lock);
+}
+
+void xshmReset(void)
+{
+    pthread_mutex_lock(&upload.lock);
+    upload.puts = 0;
+    upload.bytes = 0;
+    upload.completions = 0;
+    upload.totalLatency = 0;
+    upload.minLatency = 0;
+    upload.maxLatency = 0;
+    pthread_mutex_unlock(&upload.lock);
+}
+
+void xshmPrintStatistics(FILE* output, const char* processName, float time)
+{
+    float seconds;
+
+    pthread_mutex_lock(&upload.lock);
+    if (upload.puts)
+    {
+        seconds = (upload.lastPut - upload.firstPut) / (1000.0f * 1000.0f * 1000.0f);
+        fprintf(output,
+                "SHMU -- %.2f -- %s -- puts:%d bytes:%llu bytes_per_put:%llu mb_per_s:%.2f "
+                "completions:%d lat_min:%.2f lat_avg:%.2f lat_max:%.2f\n",
+                time, processName, upload.puts,
+                (unsigned long long)upload.bytes,
+                (unsigned long long)(upload.bytes / upload.puts),
+                seconds > 0 ? upload.bytes / (1000.0f * 1000.0f) / seconds : 0.0f,
+                upload.completions, milliseconds(upload.minLatency),
+                upload.completions ? milliseconds(upload.totalLatency / upload.completions) : 0.0f,
+                milliseconds(upload.maxLatency));
+    }
+    pthread_mutex_unlock(&upload.lock);
+}
+
+SWAPLOGGER_EXPORT Status XShmPutImage(Display* display, Drawable d, GC gc, XImage* image,
         int src_x, int src_y, int dest_x, int dest_y,
         unsigned int width, unsigned int height, Bool send_event)
 {
-    if (!real_XShmPutImage)
+    Bool trackCompletion = send_event || force_ShmCompletion;
+    Status status;
+    int slot;
+
+    /* Starts the logging threads on the first call */
+    initSwapLogger();
+
+    if (trackCompletion && !installCompletionHook(display))
+    {
+        trackCompletion = False;
+    }
+    slot = recordPut(display, d, image, height, trackCompletion, !send_event);
+
+    /* Without a slot a forced completion couldn't be filtered out */
+    if (slot < 0)
     {
-        initSwapLogger();
+        trackCompletion = send_event;
     }
 
     if (count_XSHMPutImage)
@@ -70,9 +369,14 @@ Status XShmPutImage(Display* display, Drawable d, GC gc, XImage* image,
             .x = dest_x, .y = dest_y,
             .w = width,  .h = height
         };
-        registerSwap("XSHM", 1, &rect);
+        registerSwap("XSHM", d, 1, &rect);
     }
 
-    return real_XShmPutImage(display, d, gc, image, src_x, src_y, dest_x,
-                             dest_y, width, height, send_event);
+    status = real_XShmPutImage(display, d, gc, image, src_x, src_y, dest_x,
+                               dest_y, width, height, trackCompletion);
+    if (!status && slot >= 0)
+    {
+        cancelPut(slot);
+    }
+    return status;
 }
@@ -23,10 +23,19 @@
 #ifndef SWAPLOGGER_XSHM_H
 #define SWAPLOGGER_XSHM_H
 
+#include <stdio.h>
+
 int xshmInit(void);
 void xshmCleanup();
 
+/** Shared memory upload bandwidth and ShmCompletion latency */
+void xshmReset(void);
+void xshmPrintStatistics(FILE* output, const char* processName, float time);
+
 extern int count_XSHMPutImage;
 
+/** Request ShmCompletion events even when the application doesn't */
+extern int force_ShmCompletion;
+
 #endif /* SWAPLOGGER_XSHM_H */
 
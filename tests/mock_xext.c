@@ -0,0 +1,61 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+/**
+ *  Stand-in for libXext used by test_xshm. swaplogger_xshm.c looks up
+ *  libXext.so.6 with dlopen(), so running the test with LD_LIBRARY_PATH
+ *  pointing here replaces the real library without an X server.
+ */
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#include <X11/extensions/XShm.h>
+
+#define MOCK_EVENT_BASE     64
+
+/** Arguments of the most recent put, read by the test */
+Drawable mock_lastDrawable;
+Bool mock_lastSendEvent;
+int mock_putCount;
+
+Status XShmPutImage(Display* display, Drawable d, GC gc, XImage* image,
+                    int src_x, int src_y, int dest_x, int dest_y,
+                    unsigned int width, unsigned int height, Bool send_event)
+{
+    if (!image->obdata)
+    {
+        return 0;
+    }
+
+    /* FlushGC() may send a ChangeGC request before the put itself */
+    display->request += 2;
+
+    mock_lastDrawable = d;
+    mock_lastSendEvent = send_event;
+    mock_putCount++;
+    return 1;
+}
+
+int XShmGetEventBase(Display* display)
+{
+    return MOCK_EVENT_BASE;
+}
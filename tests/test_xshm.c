@@ -0,0 +1,263 @@
+/**
+ *  Swap logger
+ *  Copyright (c) 2011 Nokia
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ *  THE SOFTWARE.
+ */
+
+/**
+ *  ShmCompletion tracking test
+ *
+ *  Runs the XShmPutImage hook against a mocked Display and libXext (see
+ *  mock_xext.c) and feeds completion events through the display's wire to
+ *  event vector, the way Xlib does when it reads them from the server.
+ *  Run with "make check".
+ */
+#include "swaplogger.h"
+#include "swaplogger_xshm.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#include <X11/extensions/XShm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#define COMPLETION_EVENT    (64 + ShmCompletion)
+#define MAX_PENDING_PUTS    256
+
+static Drawable* mock_lastDrawable;
+static Bool* mock_lastSendEvent;
+static int* mock_putCount;
+
+static int failures = 0;
+static int appEvents = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+void initSwapLogger(void)
+{
+}
+
+void registerSwap(const char* source, uintptr_t surface, int numRects,
+                  const struct Rect* rects)
+{
+}
+
+int64_t getMonotonicTime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)(t.tv_nsec) + (t.tv_sec * 1000LL * 1000LL * 1000LL);
+}
+
+float milliseconds(int64_t nanoseconds)
+{
+    return nanoseconds / (1000.0f * 1000.0f);
+}
+
+/** The application's own (libXext's) ShmCompletion handler */
+static Bool appHandler(Display* display, XEvent* re, xEvent* event)
+{
+    appEvents++;
+    return True;
+}
+
+static char shmData[4096];
+static XShmSegmentInfo shminfo = { .shmseg = 7, .shmaddr = shmData };
+
+static Status put(Display* display, Drawable d, int offset, Bool sendEvent)
+{
+    XImage image;
+
+    memset(&image, 0, sizeof(image));
+    image.data = shmData + offset;
+    image.obdata = (char*)&shminfo;
+    image.bytes_per_line = 64;
+    return XShmPutImage(display, d, NULL, &image, 0, 0, 0, 0, 16, 16, sendEvent);
+}
+
+/** Deliver a completion event; returns whether it reaches the application */
+static Bool complete(Display* display, Drawable d, int offset)
+{
+    XShmCompletionEvent e;
+    xEvent wire;
+
+    memset(&e, 0, sizeof(e));
+    memset(&wire, 0, sizeof(wire));
+    e.type = COMPLETION_EVENT;
+    e.serial = display->request;
+    e.display = display;
+    e.drawable = d;
+    e.shmseg = shminfo.shmseg;
+    e.offset = offset;
+    return display->event_vec[COMPLETION_EVENT](display, (XEvent*)&e, &wire);
+}
+
+static int completions(void)
+{
+    char* text = NULL;
+    size_t size = 0;
+    FILE* stream = open_memstream(&text, &size);
+    int count = 0;
+    char* field;
+
+    xshmPrintStatistics(stream, "test", 0);
+    fclose(stream);
+    field = strstr(text, "completions:");
+    if (field)
+    {
+        count = atoi(field + strlen("completions:"));
+    }
+    free(text);
+    return count;
+}
+
+static void testAppRequestedCompletion(Display* display)
+{
+    xshmReset();
+    force_ShmCompletion = 0;
+
+    CHECK(put(display, 1, 0, True));
+    CHECK(*mock_lastDrawable == 1);
+    CHECK(*mock_lastSendEvent == True);
+    CHECK(display->event_vec[COMPLETION_EVENT] != appHandler);
+    CHECK(complete(display, 1, 0) == True);
+    CHECK(completions() == 1);
+}
+
+static void testForcedCompletion(Display* display)
+{
+    xshmReset();
+    force_ShmCompletion = 1;
+    appEvents = 0;
+
+    CHECK(put(display, 2, 128, False));
+    CHECK(*mock_lastSendEvent == True);
+    CHECK(complete(display, 2, 128) == False);
+    CHECK(appEvents == 1);
+    CHECK(completions() == 1);
+
+    /* Both kinds mixed on one drawable, completed in request order */
+    CHECK(put(display, 2, 0, False));
+    CHECK(put(display, 2, 0, True));
+    CHECK(complete(display, 2, 0) == False);
+    CHECK(complete(display, 2, 0) == True);
+    CHECK(completions() == 3);
+}
+
+static void testPendingTableFull(Display* display)
+{
+    int i;
+
+    xshmReset();
+    force_ShmCompletion = 1;
+
+    for (i = 0; i < MAX_PENDING_PUTS; i++)
+    {
+        CHECK(put(display, 3, 0, False));
+        CHECK(*mock_lastSendEvent == True);
+    }
+
+    /* No completion is forced once it couldn't be filtered out */
+    CHECK(put(display, 3, 0, False));
+    CHECK(*mock_lastSendEvent == False);
+
+    /* Completions the application asks for still go through */
+    CHECK(put(display, 4, 0, True));
+    CHECK(*mock_lastSendEvent == True);
+
+    for (i = 0; i < MAX_PENDING_PUTS; i++)
+    {
+        CHECK(complete(display, 3, 0) == False);
+    }
+    CHECK(complete(display, 4, 0) == True);
+    CHECK(completions() == MAX_PENDING_PUTS);
+}
+
+static void testFailedPuts(Display* display)
+{
+    int i;
+
+    xshmReset();
+    force_ShmCompletion = 1;
+
+    /* Puts whose drawable went away never complete */
+    for (i = 0; i < MAX_PENDING_PUTS - 1; i++)
+    {
+        CHECK(put(display, 5, 0, False));
+    }
+    CHECK(put(display, 6, 64, True));
+    CHECK(put(display, 6, 0, False));
+    CHECK(*mock_lastSendEvent == False);
+
+    /* A later completion shows they failed and frees their slots */
+    CHECK(complete(display, 6, 64) == True);
+    CHECK(put(display, 6, 0, False));
+    CHECK(*mock_lastSendEvent == True);
+    CHECK(complete(display, 6, 0) == False);
+}
+
+int main(void)
+{
+    Display* display = calloc(1, sizeof(struct _XDisplay));
+    void* mock = dlopen("libXext.so.6", RTLD_NOW);
+
+    if (!display || !mock)
+    {
+        printf("Unable to set up the mocked display: %s\n", dlerror());
+        return 1;
+    }
+    mock_lastDrawable = dlsym(mock, "mock_lastDrawable");
+    mock_lastSendEvent = dlsym(mock, "mock_lastSendEvent");
+    mock_putCount = dlsym(mock, "mock_putCount");
+    if (!mock_lastDrawable || !mock_lastSendEvent || !mock_putCount)
+    {
+        printf("libXext.so.6 is not the mock, set LD_LIBRARY_PATH\n");
+        return 1;
+    }
+    display->event_vec[COMPLETION_EVENT] = appHandler;
+
+    /* The library does this when it is loaded */
+    if (!xshmInit())
+    {
+        printf("Unable to look up XShmPutImage\n");
+        return 1;
+    }
+
+    testAppRequestedCompletion(display);
+    testForcedCompletion(display);
+    testPendingTableFull(display);
+    testFailedPuts(display);
+
+    printf("%s: %d puts, %d failures\n", failures ? "FAIL" : "PASS",
+           *mock_putCount, failures);
+    return failures ? 1 : 0;
+}